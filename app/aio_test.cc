@@ -0,0 +1,149 @@
+#include "lib/aio.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "lib/coro.h"
+#include "lib/log.h"
+#include "lib/meta.h"
+
+namespace {
+namespace fs = std::filesystem;
+
+constexpr size_t kChunk = 4096;
+constexpr size_t kChunks = 16;
+
+auto write_chunks(AsyncIo& io, int fd) -> Task<int> {
+    std::array<std::byte, kChunk> buf{};
+    int total = 0;
+    for (size_t i = 0; i < kChunks; ++i) {
+        buf.fill(static_cast<std::byte>(i));
+        int n = co_await io.write_at(fd, buf, static_cast<off_t>(i * kChunk));
+        if (n < 0) {
+            co_return n;
+        }
+        total += n;
+    }
+    co_return total;
+}
+
+auto read_chunk(AsyncIo& io, int fd, size_t idx) -> Task<bool> {
+    std::array<std::byte, kChunk> buf{};
+    int n = co_await io.read_at(fd, buf, static_cast<off_t>(idx * kChunk));
+    if (n != static_cast<int>(kChunk)) {
+        co_return false;
+    }
+    for (auto b : buf) {
+        if (b != static_cast<std::byte>(idx)) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+auto roundtrip_fixed(AsyncIo& io, int fd, std::span<std::byte> buf) -> Task<int> {
+    int n = co_await io.write_fixed(fd, 0, buf, 0);
+    if (n < 0) {
+        co_return n;
+    }
+    std::ranges::fill(buf, std::byte{0});
+    co_return co_await io.read_fixed(fd, 0, buf, 0);
+}
+
+auto read_all(AsyncIo& io, int fd, std::span<std::byte> buf) -> Task<int> {
+    co_return co_await io.read_at(fd, buf, 0);
+}
+
+} // namespace
+
+TEST(aio, read_write) {
+    fs::path path = fs::temp_directory_path() / "aio_test.bin";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    auto rm = defer([&]() -> void {
+        close(fd);
+        fs::remove(path);
+    });
+
+    AsyncIo io;
+    INFO("aio backend {}", io.uring() ? "io_uring" : "thread pool");
+
+    auto writer = write_chunks(io, fd);
+    writer.resume();
+    io.drain();
+    EXPECT_EQ(writer.get_result(), static_cast<int>(kChunk * kChunks));
+
+    // 所有读请求同时在途, 一次 drain 批量提交
+    std::vector<Task<bool>> readers;
+    readers.reserve(kChunks);
+    for (size_t i = 0; i < kChunks; ++i) {
+        readers.push_back(read_chunk(io, fd, i));
+        readers.back().resume();
+    }
+    EXPECT_EQ(io.inflight(), kChunks);
+    io.drain();
+
+    for (auto& reader : readers) {
+        EXPECT_TRUE(reader.done());
+        EXPECT_TRUE(reader.get_result());
+    }
+}
+
+TEST(aio, fixed_buffer) {
+    fs::path path = fs::temp_directory_path() / "aio_fixed.bin";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    auto rm = defer([&]() -> void {
+        close(fd);
+        fs::remove(path);
+    });
+
+    alignas(4096) std::array<std::byte, kChunk> buf{};
+    buf.fill(std::byte{0x5a});
+
+    AsyncIo io;
+    std::array<iovec, 1> iov{iovec{.iov_base = buf.data(), .iov_len = buf.size()}};
+    ASSERT_EQ(io.register_buffers(iov), 0);
+
+    auto task = roundtrip_fixed(io, fd, buf);
+    task.resume();
+    io.drain();
+
+    EXPECT_EQ(task.get_result(), static_cast<int>(kChunk));
+    EXPECT_EQ(buf[kChunk - 1], std::byte{0x5a});
+}
+
+// 4 GiB 的 span 不能被截断成 0 长度 (看起来像 EOF), 按短读处理
+TEST(aio, huge_span) {
+    fs::path path = fs::temp_directory_path() / "aio_huge.bin";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    auto rm = defer([&]() -> void {
+        close(fd);
+        fs::remove(path);
+    });
+    const std::array<std::byte, kChunk> data{};
+    ASSERT_EQ(pwrite(fd, data.data(), data.size(), 0), static_cast<ssize_t>(kChunk));
+
+    // 只占地址空间, 实际只写到文件大小那么多页
+    constexpr size_t kHuge = size_t{1} << 32U;
+    void* mem = mmap(
+        nullptr, kHuge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT_NE(mem, MAP_FAILED);
+    auto unmap = defer([&]() -> void { munmap(mem, kHuge); });
+
+    AsyncIo io;
+    auto task = read_all(io, fd, {static_cast<std::byte*>(mem), kHuge});
+    task.resume();
+    io.drain();
+    EXPECT_EQ(task.get_result(), static_cast<int>(kChunk));
+}
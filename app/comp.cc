@@ -1,4 +1,6 @@
 #include <cstdlib>
+#include <stdexcept>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "lib/compressor.h"
@@ -40,4 +42,14 @@ TEST_F(CompressorTest, zstd) {
     INFO("zstd compressed ratio {}", float(compressed.size()) / float(origin.size()));
     auto decompressed = lz4->decompress(compressed);
     INFO("zstd decompressed size {}", decompressed.size());
-}
\ No newline at end of file
+}
+// 分块压缩的结果是首尾相连的多个帧, 要能一次解开
+TEST_F(CompressorTest, zstd_frames) {
+    auto zstd = Compressor::create(Compressor::Type::ZSTD);
+    const std::string first = origin + "first";
+    const std::string second(100000, 'x');
+    const std::string compressed = zstd->compress(first) + zstd->compress(second);
+    EXPECT_EQ(zstd->decompress(compressed), first + second);
+    EXPECT_THROW(
+        (void)zstd->decompress(compressed.substr(0, compressed.size() - 1)), std::runtime_error);
+}
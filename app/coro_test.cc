@@ -0,0 +1,76 @@
+#include "lib/coro.h"
+
+#include <stdexcept>
+#include <thread>
+
+#include "exec/static_thread_pool.hpp"
+#include "gtest/gtest.h"
+#include "lib/log.h"
+#include "stdexec/execution.hpp"
+
+namespace {
+
+auto square(int i) -> Task<int> {
+    co_return i * i;
+}
+
+auto sum_of_squares(int n) -> Task<int> {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += co_await square(i);
+    }
+    co_return sum;
+}
+
+auto on_pool(exec::static_thread_pool::scheduler sched, int i) -> Task<int> {
+    auto caller = std::this_thread::get_id();
+    co_await stdexec::schedule(sched);
+    EXPECT_NE(caller, std::this_thread::get_id());
+
+    int v = co_await (stdexec::just(i) | stdexec::then([](int x) -> int { return x + 1; }));
+    co_return v;
+}
+
+auto failed() -> Task<void> {
+    throw std::runtime_error("task failed");
+    co_return;
+}
+
+} // namespace
+
+TEST(coro, lazy) {
+    auto task = square(4);
+    EXPECT_FALSE(task.done());
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(task.get_result(), 16);
+}
+
+TEST(coro, await_task) {
+    auto [sum] = stdexec::sync_wait(sum_of_squares(4)).value();
+    EXPECT_EQ(sum, 0 + 1 + 4 + 9);
+}
+
+TEST(coro, await_sender) {
+    exec::static_thread_pool pool(3);
+    auto sched = pool.get_scheduler();
+
+    auto work = stdexec::when_all(on_pool(sched, 1), on_pool(sched, 2), on_pool(sched, 3));
+    auto [i, j, k] = stdexec::sync_wait(std::move(work)).value();
+    INFO("i = {} j = {} k = {}", i, j, k);
+    EXPECT_EQ(i + j + k, 9);
+}
+
+TEST(coro, as_sender) {
+    exec::static_thread_pool pool(2);
+    auto sched = pool.get_scheduler();
+
+    auto work = stdexec::starts_on(sched, square(5))
+                | stdexec::then([](int v) -> int { return v * 2; });
+    auto [v] = stdexec::sync_wait(std::move(work)).value();
+    EXPECT_EQ(v, 50);
+}
+
+TEST(coro, exception) {
+    EXPECT_THROW(stdexec::sync_wait(failed()), std::runtime_error);
+}
@@ -1,6 +1,12 @@
 #include <cstdint>
+#include <random>
 
-#include <immintrin.h>
+#if defined(__x86_64__)
+    #include <immintrin.h>
+#endif
+
+#include "gtest/gtest.h"
+#include "lib/meta.h"
 
 struct U128 {
     uint64_t low = 0;
@@ -13,11 +19,67 @@ auto operator*(U128 a, U128 b) -> U128;
 auto operator==(U128 a, U128 b) -> bool;
 auto operator<(U128 a, U128 b) -> bool;
 
+namespace u128 {
+
+using uint128 = unsigned __int128;
+
+inline auto to_native(U128 v) -> uint128 {
+    return (static_cast<uint128>(v.high) << 64U) | v.low;
+}
+
+inline auto from_native(uint128 v) -> U128 {
+    return {.low = static_cast<uint64_t>(v), .high = static_cast<uint64_t>(v >> 64U)};
+}
+
+using MulFn = auto (*)(U128, U128) -> U128;
+
+// 只用基础指令集, 任何 CPU 都能跑
+inline auto mul_generic(U128 a, U128 b) -> U128 {
+    return from_native(to_native(a) * to_native(b));
+}
+
+#if defined(__x86_64__)
+// mulx 需要 BMI2, 只给这一个函数打开, 没有 BMI2 的机器不会走到这里
+__attribute__((target("bmi2"))) inline auto mul_bmi2(U128 a, U128 b) -> U128 {
+    U128 r;
+
+    uint64_t p0_hi = 0;
+    r.low = _mulx_u64(a.low, b.low, &p0_hi);
+
+    // cross terms: only the low 64 bits contribute to r.high
+    uint64_t t1_hi = 0;
+    uint64_t t1_lo = _mulx_u64(a.low, b.high, &t1_hi);
+
+    uint64_t t2_hi = 0;
+    uint64_t t2_lo = _mulx_u64(a.high, b.low, &t2_hi);
+
+    // simply add is sufficient: carries would land in bit 128 and are discarded
+    r.high = p0_hi + t1_lo + t2_lo;
+
+    return r;
+}
+#endif
+
+// 第一次调用时按 CPU 特性选定实现
+inline auto mul_kernel() -> MulFn {
+    static const MulFn kernel = select_kernel<MulFn>({
+#if defined(__x86_64__)
+        {CpuInfo::get().isa.bmi2, mul_bmi2},
+#endif
+        {true, mul_generic},
+    });
+    return kernel;
+}
+
+} // namespace u128
+
 inline auto operator==(U128 a, U128 b) -> bool {
     return a.low == b.low && a.high == b.high;
 }
 
+// adc / sbb 属于 x86-64 基础指令集, 不需要分发
 inline auto operator<(U128 a, U128 b) -> bool {
+#if defined(__x86_64__)
     uint64_t dont_care = 0;
 
     // compute borrow from (a.low - b.low). If a.low < b.low => borrow = 1.
@@ -28,37 +90,59 @@ inline auto operator<(U128 a, U128 b) -> bool {
     borrow = _subborrow_u64(borrow, a.high, b.high, &dont_care);
 
     return borrow != 0;
+#else
+    return u128::to_native(a) < u128::to_native(b);
+#endif
 }
 
 inline auto operator+(U128 a, U128 b) -> U128 {
+#if defined(__x86_64__)
     U128 r;
     unsigned char c = _addcarry_u64(0, a.low, b.low, &r.low);
     (void)_addcarry_u64(c, a.high, b.high, &r.high);
     return r;
+#else
+    return u128::from_native(u128::to_native(a) + u128::to_native(b));
+#endif
 }
 
 inline auto operator-(U128 a, U128 b) -> U128 {
+#if defined(__x86_64__)
     U128 r;
     unsigned char c = _subborrow_u64(0, a.low, b.low, &r.low);
     (void)_subborrow_u64(c, a.high, b.high, &r.high);
     return r;
+#else
+    return u128::from_native(u128::to_native(a) - u128::to_native(b));
+#endif
 }
 
 inline auto operator*(U128 a, U128 b) -> U128 {
-    U128 r;
-
-    uint64_t p0_hi = 0;
-    r.low = _mulx_u64(a.low, b.low, &p0_hi);
+    return u128::mul_kernel()(a, b);
+}
 
-    // cross terms: only the low 64 bits contribute to r.high
-    uint64_t t1_hi = 0;
-    uint64_t t1_lo = _mulx_u64(a.low, b.high, &t1_hi);
+TEST(U128, arithmetic) {
+    const U128 max{.low = UINT64_MAX, .high = 0};
+    const U128 one{.low = 1, .high = 0};
 
-    uint64_t t2_hi = 0;
-    uint64_t t2_lo = _mulx_u64(a.high, b.low, &t2_hi);
-
-    // simply add is sufficient: carries would land in bit 128 and are discarded
-    r.high = p0_hi + t1_lo + t2_lo;
+    EXPECT_EQ(max + one, (U128{.low = 0, .high = 1}));
+    EXPECT_EQ((U128{.low = 0, .high = 1}) - one, max);
+    EXPECT_EQ(max * max, (U128{.low = 1, .high = UINT64_MAX - 1}));
+    EXPECT_TRUE(max < (U128{.low = 0, .high = 1}));
+    EXPECT_FALSE((U128{.low = 0, .high = 1}) < max);
+}
 
-    return r;
+TEST(U128, dispatch) {
+    std::mt19937_64 rng(42);
+    for (int i = 0; i < 1000; ++i) {
+        const U128 a{.low = rng(), .high = rng()};
+        const U128 b{.low = rng(), .high = rng()};
+        const U128 expected = u128::mul_generic(a, b);
+        EXPECT_EQ(a * b, expected);
+#if defined(__x86_64__)
+        if (CpuInfo::get().isa.bmi2) {
+            EXPECT_EQ(u128::mul_bmi2(a, b), expected);
+        }
+#endif
+    }
 }
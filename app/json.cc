@@ -1,9 +1,26 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "lib/json.h"
+#include "lib/jsonl.h"
 #include "lib/log.h"
 #include "rapidjson/document.h"
 #include "rapidjson/pointer.h"
@@ -18,13 +35,13 @@ constexpr bool always_false_v = AlwaysFalse<T>::value;
 
 template <typename T>
 auto get_value(const rapidjson::Document& doc, const char* path, T& dst) {
-    rapidjson::Pointer pointer(path);
-    if (!pointer.IsValid()) {
+    const rapidjson::Pointer* pointer = json::pointer(path);
+    if (!pointer) {
         ERROR("Invalid JSON pointer syntax: {}", path);
         return;
     }
 
-    const rapidjson::Value* value = pointer.Get(doc);
+    const rapidjson::Value* value = pointer->Get(doc);
     if (!value) {
         return;
     }
@@ -65,33 +82,6 @@ auto get_value(const rapidjson::Document& doc, const char* path, T& dst) {
     }
 }
 
-template <typename T>
-void settter(rapidjson::Document& doc, std::string_view key, const T& target) {
-    rapidjson::Value kval(key.data(), key.size(), doc.GetAllocator());
-
-    if constexpr (std::is_arithmetic_v<T> or std::is_same_v<T, bool>) {
-        rapidjson::Value vval(target);
-        doc.AddMember(kval.Move(), vval.Move(), doc.GetAllocator());
-    }
-
-    if constexpr (std::is_same_v<std::remove_cvref_t<T>, std::string>) {
-        rapidjson::Value vval(target.c_str(), target.size(), doc.GetAllocator());
-        doc.AddMember(kval.Move(), vval.Move(), doc.GetAllocator());
-    }
-
-    if constexpr (std::is_convertible_v<T, std::string_view>) {
-        rapidjson::Value vval(target.data(), target.size(), doc.GetAllocator());
-        doc.AddMember(kval.Move(), vval.Move(), doc.GetAllocator());
-    }
-
-    if constexpr (std::is_null_pointer_v<T> or std::is_same_v<T, std::nullptr_t>) {
-        rapidjson::Value vval;
-        vval.SetNull();
-        doc.AddMember(kval.Move(), vval.Move(), doc.GetAllocator());
-    }
-}
-
-#define SET(key) settter(doc, #key, key)
 #define GET(key) get_value(doc, "/" #key, key)
 
 namespace json {
@@ -102,21 +92,9 @@ struct Item {
     int32_t boost = 1;
     bool enable = false;
 
-    [[nodiscard]] auto toStr() const -> std::string {
-        rapidjson::Document doc;
-        doc.SetObject();
-
-        SET(id);
-        SET(score);
-        SET(coef);
-        SET(boost);
-        SET(enable);
+    JSON_FIELDS(Item, id, score, coef, boost, enable)
 
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        doc.Accept(writer);
-        return buffer.GetString();
-    }
+    [[nodiscard]] auto toStr() const -> std::string { return to_json(*this); }
 
     [[nodiscard]] auto toStrV2() const -> std::string {
         rapidjson::StringBuffer buffer;
@@ -145,20 +123,24 @@ struct Item {
 
     Item() = default;
 
+    // 解析失败时保持默认值
     explicit Item(const std::string& json) {
-        rapidjson::Document doc;
-        doc.Parse(json.data());
-
-        if (doc.HasParseError()) {
-            return;
+        Item parsed;
+        if (from_json(json, parsed)) {
+            *this = parsed;
         }
-        GET(id);
-        GET(score);
-        GET(coef);
-        GET(boost);
-        GET(enable);
     }
 };
+
+// 只读视图: 字符串字段指向 from_json_insitu 的输入, 不拷贝
+struct ItemView {
+    int64_t id = 0;
+    std::string_view brand;
+    std::vector<std::string_view> tags;
+    std::map<std::string_view, std::string_view> attrs;
+
+    JSON_FIELDS(ItemView, id, brand, tags, attrs)
+};
 } // namespace json
 
 TEST(tojson, tojson) {
@@ -179,9 +161,380 @@ TEST(tojson, fromjson) {
         = R"({"id":1024,"score":3.14,"coef":2.0999999046325684,"boost":2,"enable":true})";
 
     json::Item item(tmp);
-
     INFO("item info {}", item.toStr());
+
+    // 和 DOM + Pointer 逐字段读取的结果一致
+    rapidjson::Document doc;
+    doc.Parse(tmp.data());
+    int64_t id = 0;
+    double score = 0;
+    float coef = 0;
+    int32_t boost = 0;
+    bool enable = false;
+    GET(id);
+    GET(score);
+    GET(coef);
+    GET(boost);
+    GET(enable);
+
+    EXPECT_EQ(item.id, id);
+    EXPECT_EQ(item.score, score);
+    EXPECT_EQ(item.coef, coef);
+    EXPECT_EQ(item.boost, boost);
+    EXPECT_EQ(item.enable, enable);
+    EXPECT_EQ(item.toStr(), tmp);
+
+    json::Item broken(R"({"id":1,"score":)");
+    EXPECT_EQ(broken.id, 0);
+}
+
+namespace {
+
+struct Sku {
+    int64_t id = 0;
+    std::string name;
+    std::optional<double> price;
+
+    JSON_FIELDS(Sku, id, name, price)
+};
+
+struct Spu {
+    uint64_t id = 0;
+    std::vector<int64_t> tags;
+    std::vector<Sku> skus;
+    std::map<std::string, std::vector<int32_t>> groups;
+    std::unordered_map<int, std::string> names;
+
+    JSON_FIELDS(Spu, id, tags, skus, groups, names)
+};
+
+struct Arrays {
+    std::vector<int64_t> spuids;
+    std::vector<uint8_t> flags;
+    std::vector<double> scores;
+    std::vector<float> coefs;
+    std::vector<std::string> tags;
+
+    JSON_FIELDS(Arrays, spuids, flags, scores, coefs, tags)
+
+    auto operator==(const Arrays&) const -> bool = default;
+};
+
+// 同一个输入分别走快速路径和逐 token 解析, 结果必须一致
+template <unsigned Flags>
+void expect_same_arrays(const std::string& input) {
+    Arrays slow;
+    json::set_fast_paths(false);
+    const bool slow_ok = json::from_json<Flags>(input, slow);
+    Arrays fast;
+    json::set_fast_paths(true);
+    EXPECT_EQ(json::from_json<Flags>(input, fast), slow_ok) << input;
+    EXPECT_EQ(fast, slow) << input;
+}
+
+} // namespace
+
+TEST(tojson, reflect) {
+    Spu spu;
+    spu.id = 42;
+    spu.tags = {1, 2, 3};
+    spu.skus = {{.id = 7, .name = "a\"b", .price = 1.5}, {.id = 8, .name = "c", .price = {}}};
+    spu.groups = {{"x", {1, 2}}, {"y", {}}};
+    spu.names = {{9, "nine"}};
+
+    EXPECT_EQ(
+        json::to_json(spu),
+        R"({"id":42,"tags":[1,2,3],"skus":[{"id":7,"name":"a\"b","price":1.5},)"
+        R"({"id":8,"name":"c","price":null}],"groups":{"x":[1,2],"y":[]},"names":{"9":"nine"}})");
+
+    // 追加写, 不清空已有内容
+    Sku sku;
+    sku.id = 1;
+    std::string dst = "prefix:";
+    json::to_json(sku, dst);
+    EXPECT_EQ(dst, R"(prefix:{"id":1,"name":"","price":null})");
+}
+
+TEST(tojson, reflect_parse) {
+    const std::string text
+        = R"({"id":42,"tags":[1,2,3],"skus":[{"id":7,"name":"a\"b","price":1.5},)"
+          R"({"id":8,"name":"c","price":null}],"groups":{"x":[1,2],"y":[]},"names":{"9":"nine"}})";
+    Spu spu;
+    ASSERT_TRUE(json::from_json(text, spu));
+    EXPECT_EQ(json::to_json(spu), text);
+
+    // 未知 key 整体跳过, 类型不对或越界的值忽略, 数组里这样的元素保留默认值
+    Spu other;
+    other.id = 5;
+    ASSERT_TRUE(json::from_json(
+        R"({"extra":{"a":[1,{"b":null}]},"id":-3,"tags":[-1,"2",3],"names":{"k":"v","1":"a"}})",
+        other));
+    EXPECT_EQ(other.id, 5);
+    EXPECT_EQ(other.tags, (std::vector<int64_t>{-1, 0, 3}));
+    EXPECT_EQ(other.names, (std::unordered_map<int, std::string>{{1, "a"}}));
+
+    Sku sku;
+    ASSERT_TRUE(json::from_json(R"({"id":-1,"price":2})", sku));
+    EXPECT_EQ(sku.id, -1);
+    EXPECT_EQ(sku.price, 2.0);
+
+    EXPECT_FALSE(json::from_json(R"({"id":1)", sku));
+    EXPECT_FALSE(json::from_json(R"({"id":1} trailing)", sku));
+    EXPECT_FALSE(json::from_json("", sku));
+
+    // 根必须是对象
+    for (const std::string_view root : {"null", "42", "[1,2]", R"("s")", "[{\"id\":1}]"}) {
+        EXPECT_FALSE(json::from_json(root, sku)) << root;
+        std::string buffer(root);
+        EXPECT_FALSE(json::from_json_insitu(buffer, sku)) << root;
+    }
+    EXPECT_EQ(sku.id, -1);
+}
+
+TEST(tojson, context) {
+    auto& ctx = json::Context::local();
+
+    // 比 arena 大得多的文档触发扩容, 超过 kMaxArena 的文档溢出到额外的块, 之后回到小文档,
+    // 内容都不能串
+    static_assert(500000 * sizeof(rapidjson::Value) > json::Context::kMaxArena);
+    for (const size_t n : {size_t{4}, size_t{50000}, size_t{500000}, size_t{500000}, size_t{4}}) {
+        auto& doc = ctx.document();
+        rapidjson::Value arr(rapidjson::kArrayType);
+        for (size_t i = 0; i < n; ++i) {
+            arr.PushBack(static_cast<uint64_t>(i), doc.GetAllocator());
+        }
+        doc.AddMember("n", static_cast<uint64_t>(n), doc.GetAllocator());
+        doc.AddMember("arr", arr, doc.GetAllocator());
+
+        std::string dst = "x";
+        doc.Accept(ctx.writer(dst));
+        EXPECT_TRUE(dst.starts_with(R"(x{"n":)" + std::to_string(n) + R"(,"arr":[0,1,2,3)"));
+        EXPECT_TRUE(dst.ends_with(std::to_string(n - 1) + "]}"));
+
+        auto& writer = ctx.buffer_writer();
+        doc.Accept(writer);
+        EXPECT_EQ(std::string_view(ctx.buffer().GetString(), dst.size() - 1), dst.substr(1));
+    }
+}
+
+TEST(tojson, pointer_cache) {
+    const rapidjson::Pointer* p = json::pointer("/skus/1/name");
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(json::pointer(std::string("/skus/1/name")), p);
+    EXPECT_NE(json::pointer("/skus/0/name"), p);
+    EXPECT_EQ(json::pointer("no-leading-slash"), nullptr);
+    EXPECT_EQ(json::pointer("/bad~2escape"), nullptr);
+
+    rapidjson::Document doc;
+    doc.Parse(R"({"skus":[{"name":"a"},{"name":"b"}]})");
+    std::string name;
+    get_value(doc, "/skus/1/name", name);
+    EXPECT_EQ(name, "b");
+
+    // 多线程同时首次访问同一批 path, 拿到的必须是同一个对象
+    std::vector<std::thread> threads;
+    std::vector<std::vector<const rapidjson::Pointer*>> seen(4);
+    for (size_t t = 0; t < seen.size(); ++t) {
+        threads.emplace_back([&seen, t] -> void {
+            for (int i = 0; i < 64; ++i) {
+                seen[t].push_back(json::pointer("/concurrent/" + std::to_string(i)));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& s : seen) {
+        EXPECT_EQ(s, seen[0]);
+    }
+}
+
+TEST(tojson, insitu) {
+    std::string buffer
+        = R"({"id":7,"brand":"a\"b","tags":["x","yz"],"attrs":{"k":"v"},"skip":[1]})";
+    const char* begin = buffer.data();
+    const char* end = begin + buffer.size();
+    auto inside = [begin, end](std::string_view s) -> bool {
+        return s.data() >= begin && s.data() + s.size() <= end;
+    };
+
+    json::ItemView view;
+    ASSERT_TRUE(json::from_json_insitu(buffer, view));
+    EXPECT_EQ(view.id, 7);
+    EXPECT_EQ(view.brand, "a\"b");
+    EXPECT_TRUE(inside(view.brand));
+    EXPECT_EQ(view.tags, (std::vector<std::string_view>{"x", "yz"}));
+    EXPECT_TRUE(inside(view.tags[1]));
+    ASSERT_EQ(view.attrs.size(), 1U);
+    EXPECT_TRUE(inside(view.attrs.begin()->first));
+    EXPECT_EQ(view.attrs.begin()->second, "v");
+    EXPECT_EQ(
+        json::to_json(view), R"({"id":7,"brand":"a\"b","tags":["x","yz"],"attrs":{"k":"v"}})");
+
+    // DOM 版本: 节点在 Context 的内存池里, 字符串同样指向 buffer
+    std::string dom_buffer = R"({"brand":"nike","id":9})";
+    auto& doc = json::Context::local().parse_insitu(dom_buffer);
+    ASSERT_FALSE(doc.HasParseError());
+    std::string_view brand;
+    get_value(doc, "/brand", brand);
+    EXPECT_EQ(brand, "nike");
+    EXPECT_GE(brand.data(), dom_buffer.data());
+    EXPECT_LT(brand.data(), dom_buffer.data() + dom_buffer.size());
+
+    std::string broken = R"({"id":)";
+    EXPECT_TRUE(json::Context::local().parse_insitu(broken).HasParseError());
+}
+
+TEST(tojson, json_lines) {
+    const auto path = std::filesystem::temp_directory_path() / "json_lines_test.jsonl";
+    constexpr int64_t kRecords = 5000;
+    {
+        std::ofstream out(path, std::ios::trunc);
+        for (int64_t i = 0; i < kRecords; ++i) {
+            json::Item item;
+            item.id = i;
+            out << item.toStr() << (i % 7 == 0 ? "\r\n" : "\n");
+            if (i % 1000 == 0) {
+                out << "not json\n\n  \nnull\n42\n[1,2]\n\"s\"\n";
+            }
+        }
+    }
+
+    json::LinesOptions opts;
+    opts.threads = 4;
+    opts.chunk_size = 512;
+
+    // 有序: chunk 编号连续, 记录和文件里的顺序一致
+    std::vector<int64_t> ids;
+    size_t expected_chunk = 0;
+    auto stats = json::read_lines<json::Item>(
+        path.string(),
+        [&](size_t chunk, std::span<json::Item> items) -> void {
+            EXPECT_EQ(chunk, expected_chunk++);
+            for (const auto& item : items) {
+                ids.push_back(item.id);
+            }
+        },
+        opts);
+    EXPECT_EQ(stats.records, static_cast<size_t>(kRecords));
+    // 每 1000 条插入的 5 行非对象
+    EXPECT_EQ(stats.bad_lines, 25U);
+    EXPECT_EQ(stats.chunks, expected_chunk);
+    EXPECT_GT(stats.chunks, opts.threads);
+    ASSERT_EQ(ids.size(), static_cast<size_t>(kRecords));
+    for (int64_t i = 0; i < kRecords; ++i) {
+        ASSERT_EQ(ids[static_cast<size_t>(i)], i);
+    }
+
+    // 无序: consumer 并发调用, 记录不丢不重
+    opts.ordered = false;
+    std::mutex mutex;
+    ids.clear();
+    stats = json::read_lines<json::Item>(
+        path.string(),
+        [&](size_t /*chunk*/, std::span<json::Item> items) -> void {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& item : items) {
+                ids.push_back(item.id);
+            }
+        },
+        opts);
+    EXPECT_EQ(stats.records, static_cast<size_t>(kRecords));
+    std::ranges::sort(ids);
+    ASSERT_EQ(ids.size(), static_cast<size_t>(kRecords));
+    EXPECT_EQ(ids.back(), kRecords - 1);
+
+    // consumer 的异常传回调用方
+    opts.ordered = true;
+    EXPECT_THROW(
+        json::read_lines<json::Item>(
+            path.string(),
+            [](size_t chunk, std::span<json::Item> /*items*/) -> void {
+                if (chunk == 3) {
+                    throw std::runtime_error("stop");
+                }
+            },
+            opts),
+        std::runtime_error);
+
+    EXPECT_THROW(
+        json::read_lines<json::Item>(
+            path.string() + ".missing",
+            [](size_t /*chunk*/, std::span<json::Item> /*items*/) -> void {}),
+        std::system_error);
+
+    std::filesystem::remove(path);
+}
+
+TEST(tojson, simd) {
+    // 各种长度和偏移下 SIMD 扫描和标量结果一致, 并且不读过 end
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += std::string(static_cast<size_t>(i % 37), i % 2 == 0 ? ' ' : 'x');
+        text += "\"\\\n\t\x01\xe4\xb8\xad";
+    }
+    const char* end = text.data() + text.size();
+    for (const char* p = text.data(); p <= end; ++p) {
+        json::set_fast_paths(false);
+        const char* space = json::detail::skip_space(p, end);
+        const char* special = json::detail::scan_string(p, end);
+        json::set_fast_paths(true);
+        ASSERT_EQ(json::detail::skip_space(p, end), space);
+        ASSERT_EQ(json::detail::scan_string(p, end), special);
+    }
+    EXPECT_FALSE(json::simd_name().empty());
+
+    // 快速路径和逐 token 解析的结果一致, 包括需要退回 Reader 的数组
+    const std::vector<std::string> inputs = {
+        R"({"spuids":[1,-2, 1234567890123 ,-9223372036854775808],"flags":[0,255],)"
+        R"("scores":[1.5,-0.5,2e3,0.1],"coefs":[1,2.5],"tags":["a","b\"c\\",)"
+        R"("\u00e9\ud83d\ude00\n"]})",
+        "{ \"spuids\" : [ 1 ,\n\t2 ] , \"tags\" : [ ] }",
+        // 越界, 类型不符, null, 嵌套, 前导 0, 非法转义, 尾随逗号, 溢出: 快速路径放弃, 行为和原来一样
+        R"({"flags":[1,256,3],"spuids":[1,"x",null,3],"scores":[1,{"a":1},[2]],)"
+        R"("tags":["a",1,"b"],"coefs":[1,null]})",
+        R"({"spuids":[01]})",
+        R"({"tags":["\ud800"]})",
+        R"({"spuids":[1,2,]})",
+        R"({"scores":[1e999]})",
+    };
+    for (const auto& input : inputs) {
+        expect_same_arrays<rapidjson::kParseDefaultFlags>(input);
+        expect_same_arrays<rapidjson::kParseFullPrecisionFlag>(input);
+    }
+
+    // 17 位有效数字的浮点数: 默认 flags 下浮点数组不走快速路径, 和 Reader 一致;
+    // kParseFullPrecisionFlag 下两边都正确舍入, 读回来和原值完全相同
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> mantissa(-10.0, 10.0);
+    std::uniform_int_distribution<int> exponent(-30, 30);
+    std::vector<double> values;
+    std::string numbers;
+    for (int i = 0; i < 2000; ++i) {
+        values.push_back(mantissa(rng) * std::pow(10.0, exponent(rng)));
+        numbers += std::format("{}{:.17g}", i == 0 ? "" : ",", values.back());
+    }
+    const std::string precise = R"({"scores":[)" + numbers + R"(],"coefs":[)" + numbers + "]}";
+    expect_same_arrays<rapidjson::kParseDefaultFlags>(precise);
+    expect_same_arrays<rapidjson::kParseFullPrecisionFlag>(precise);
+    Arrays exact;
+    ASSERT_TRUE(json::from_json<rapidjson::kParseFullPrecisionFlag>(precise, exact));
+    EXPECT_EQ(exact.scores, values);
+    ASSERT_EQ(exact.coefs.size(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(exact.coefs[i], static_cast<float>(values[i])) << i;
+    }
+
+    Arrays arrays;
+    ASSERT_TRUE(json::from_json(inputs[0], arrays));
+    EXPECT_EQ(arrays.spuids, (std::vector<int64_t>{1, -2, 1234567890123, INT64_MIN}));
+    EXPECT_EQ(arrays.scores, (std::vector<double>{1.5, -0.5, 2000, 0.1}));
+    EXPECT_EQ(arrays.tags, (std::vector<std::string>{"a", "b\"c\\", "\u00e9\U0001F600\n"}));
+
+    ASSERT_TRUE(json::from_json(inputs[2], arrays));
+    EXPECT_EQ(arrays.flags, (std::vector<uint8_t>{1, 0, 3}));
+    EXPECT_EQ(arrays.spuids, (std::vector<int64_t>{1, 0, 0, 3}));
+    EXPECT_FALSE(json::from_json(inputs[3], arrays));
 }
 
-#undef SET
 #undef GET
\ No newline at end of file
@@ -0,0 +1,407 @@
+#include "lib/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "lib/compressor.h"
+#include "lib/log_sink.h"
+#include "rapidjson/document.h"
+
+TEST(log, async) {
+    logging::AsyncOptions opts;
+    opts.buffer_size = 64 * 1024;
+    opts.overflow = logging::Overflow::BLOCK;
+    logging::start_async(opts);
+    EXPECT_TRUE(logging::async_enabled());
+
+    std::vector<std::thread> threads;
+    threads.reserve(4);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t] -> void {
+            for (int i = 0; i < 100; ++i) {
+                INFO("async thread {} record {}", t, i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    logging::flush();
+    logging::stop_async();
+    EXPECT_FALSE(logging::async_enabled());
+    EXPECT_EQ(logging::dropped(), 0U);
+
+    INFO("back to sync mode");
+}
+
+TEST(log, deferred) {
+    const auto path = std::filesystem::temp_directory_path() / "log_deferred.bin";
+    std::filesystem::remove(path);
+
+    logging::AsyncOptions opts;
+    opts.deferred = true;
+    opts.binary_path = path.string();
+    logging::start_async(opts);
+
+    std::string name = "deferred";
+    INFO("{} id={} score={:.2f} coef={} ok={} tag={}", name, 42, 3.14159, 1.5F, true, 'x');
+    INFO("{1}-{0} hex={2:#x}", "b", "a", 255U);
+    logging::stop_async();
+
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::filesystem::remove(path);
+
+    const std::string text = logging::decode(data);
+    EXPECT_NE(text.find("deferred id=42 score=3.14 coef=1.5 ok=true tag=x"), std::string::npos);
+    EXPECT_NE(text.find("a-b hex=0xff"), std::string::npos);
+    EXPECT_NE(text.find("log_test.cc"), std::string::npos);
+}
+
+// 线程退出后 ring 被回收, 新线程的 ring 可能分配在同一地址上, 解码时仍要对应各自的线程 id
+TEST(log, deferred_thread_ids) {
+    const auto path = std::filesystem::temp_directory_path() / "log_thread_ids.bin";
+    std::filesystem::remove(path);
+
+    logging::AsyncOptions opts;
+    opts.deferred = true;
+    opts.binary_path = path.string();
+    logging::start_async(opts);
+
+    std::vector<std::string> tids;
+    for (int t = 0; t < 4; ++t) {
+        std::thread([&tids, t] -> void {
+            std::ostringstream oss;
+            oss << std::this_thread::get_id();
+            tids.push_back(oss.str());
+            INFO("thread record {}", t);
+        }).join();
+        // 读空并回收已退出线程的 ring
+        logging::flush();
+        logging::flush();
+    }
+    logging::stop_async();
+
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::filesystem::remove(path);
+
+    const std::string text = logging::decode(data);
+    for (size_t t = 0; t < tids.size(); ++t) {
+        const auto end = text.find("thread record " + std::to_string(t));
+        ASSERT_NE(end, std::string::npos);
+        const auto newline = text.rfind('\n', end);
+        const auto begin = newline == std::string::npos ? 0 : newline + 1;
+        const std::string line = text.substr(begin, end - begin);
+        EXPECT_NE(line.find("[" + tids[t] + "] [INFO]"), std::string::npos) << line;
+    }
+}
+
+// 崩溃时先把 ring 里的日志写出, 再交给安装之前的 handler
+TEST(log, crash_chains_previous_handler) {
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(
+        {
+            struct sigaction sa {};
+            sa.sa_handler = [](int /*sig*/) -> void { ::_exit(42); };
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGABRT, &sa, nullptr);
+            logging::start_async();
+            INFO("before abort");
+            std::abort();
+        },
+        testing::ExitedWithCode(42),
+        "before abort");
+}
+
+TEST(log, level) {
+    int evaluated = 0;
+    auto count = [&evaluated]() -> int { return ++evaluated; };
+
+    logging::set_level(LogLevel::WARN);
+    DEBUG("debug {}", count());
+    INFO("info {}", count());
+    EXPECT_EQ(evaluated, 0);
+
+    WARN("warn {}", count());
+    EXPECT_EQ(evaluated, 1);
+
+    logging::set_level(LogLevel::TRACE);
+    EXPECT_TRUE(logging::enabled(LogLevel::TRACE));
+}
+
+TEST(log, rotating_sink) {
+    const auto dir = std::filesystem::temp_directory_path() / "log_rotate_test";
+    std::filesystem::remove_all(dir);
+
+    logging::RotateOptions opts;
+    opts.path = (dir / "app.log").string();
+    opts.max_bytes = 4 * 1024;
+    opts.buffer_size = 1024;
+    opts.max_files = 3;
+    auto sink = std::make_shared<logging::RotatingFileSink>(opts);
+    logging::set_sink(sink);
+
+    for (int i = 0; i < 500; ++i) {
+        INFO("rotating sink record {}", i);
+    }
+    logging::flush();
+    sink->wait_idle();
+    logging::set_sink(nullptr);
+
+    std::vector<std::filesystem::path> archives;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".zst") {
+            archives.push_back(entry.path());
+        }
+    }
+    EXPECT_EQ(archives.size(), 3U);
+    ASSERT_FALSE(archives.empty());
+
+    std::ranges::sort(archives);
+    std::ifstream in(archives.back(), std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::string text = Compressor::create(Compressor::Type::ZSTD)->decompress(data);
+    EXPECT_NE(text.find("rotating sink record"), std::string::npos);
+    EXPECT_EQ(text.find("\033["), std::string::npos);
+
+    std::filesystem::remove_all(dir);
+}
+
+// 用户线程直接 rotate 和其他线程的 write 并发, 记录不丢不乱
+TEST(log, rotating_sink_concurrent_rotate) {
+    const auto dir = std::filesystem::temp_directory_path() / "log_rotate_race_test";
+    std::filesystem::remove_all(dir);
+
+    logging::RotateOptions opts;
+    opts.path = (dir / "app.log").string();
+    opts.max_bytes = 0;
+    opts.buffer_size = 512;
+    opts.max_files = 0;
+    opts.compress = false;
+    auto sink = std::make_shared<logging::RotatingFileSink>(opts);
+    logging::set_sink(sink);
+
+    // 同步模式下打日志的线程直接在 sink 上 write
+    constexpr int kRecords = 2000;
+    std::atomic<bool> started{false};
+    std::atomic<bool> done{false};
+    std::thread rotator([&] -> void {
+        started.store(true);
+        while (!done.load()) {
+            sink->rotate();
+            std::this_thread::yield();
+        }
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < kRecords; ++i) {
+        INFO("rotate race record {}", i);
+    }
+    done.store(true);
+    rotator.join();
+    sink->flush();
+    sink->wait_idle();
+    logging::set_sink(nullptr);
+
+    size_t records = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        std::ifstream in(entry.path());
+        for (std::string line; std::getline(in, line);) {
+            EXPECT_NE(line.find("rotate race record"), std::string::npos) << line;
+            ++records;
+        }
+    }
+    EXPECT_EQ(records, static_cast<size_t>(kRecords));
+
+    std::filesystem::remove_all(dir);
+}
+
+namespace {
+
+struct CaptureSink : logging::Sink {
+    std::string text;
+
+    void write(std::string_view data) override { text.append(data); }
+
+    [[nodiscard]] auto count(std::string_view needle) const -> size_t {
+        size_t n = 0;
+        for (auto pos = text.find(needle); pos != std::string::npos;
+             pos = text.find(needle, pos + needle.size())) {
+            ++n;
+        }
+        return n;
+    }
+
+    // 所有 "suppressed N messages" 里 N 的总和
+    [[nodiscard]] auto suppressed() const -> uint64_t {
+        constexpr std::string_view needle = "suppressed ";
+        uint64_t sum = 0;
+        for (auto pos = text.find(needle); pos != std::string::npos;
+             pos = text.find(needle, pos)) {
+            pos += needle.size();
+            sum += std::stoull(text.substr(pos, text.find(' ', pos) - pos));
+        }
+        return sum;
+    }
+};
+
+} // namespace
+
+// 动态宽度 / 精度的格式串不走延迟格式化, 输出和同步模式一致
+TEST(log, deferred_dynamic_spec) {
+    static_assert(logging::detail::has_dynamic_spec("{:>{}}"));
+    static_assert(logging::detail::has_dynamic_spec("{0:.{1}f}"));
+    static_assert(!logging::detail::has_dynamic_spec("{{}} {:>8} {1}"));
+
+    auto sink = std::make_shared<CaptureSink>();
+    logging::set_sink(sink);
+    logging::AsyncOptions opts;
+    opts.deferred = true;
+    logging::start_async(opts);
+
+    std::string name = "ab";
+    INFO("[{:>{}}] [{:.{}f}] next={}", name, 5, 3.14159, 2, 7);
+    logging::flush();
+    logging::stop_async();
+    logging::set_sink(nullptr);
+
+    EXPECT_NE(sink->text.find("[   ab] [3.14] next=7"), std::string::npos) << sink->text;
+}
+
+TEST(log, rate_limit) {
+    auto sink = std::make_shared<CaptureSink>();
+    logging::set_sink(sink);
+
+    for (int i = 0; i < 1000; ++i) {
+        LOG_EVERY_N(LogLevel::INFO, 100, "sampled {}", i);
+    }
+    EXPECT_EQ(sink->count("sampled"), 10U);
+    // 丢弃条数每秒最多报告一次, 循环可能恰好跨过秒边界
+    EXPECT_LE(sink->count("suppressed"), 2U);
+    // 剩下的在 flush 时补报, 一条都不少
+    logging::flush();
+    EXPECT_EQ(sink->suppressed(), 990U);
+
+    for (int i = 0; i < 1000; ++i) {
+        LOG_PER_SECOND(LogLevel::WARN, 5, "limited {}", i);
+    }
+    // 循环可能恰好跨过秒边界, 最多放行两个窗口
+    const size_t limited = sink->count("limited");
+    EXPECT_GE(limited, 5U);
+    EXPECT_LE(limited, 10U);
+    // 之后没有流量, 丢弃条数也不能丢
+    logging::flush();
+    EXPECT_EQ(sink->suppressed(), 990U + 1000U - limited);
+
+    logging::set_sink(nullptr);
+}
+
+TEST(log, sampled) {
+    auto sink = std::make_shared<CaptureSink>();
+    logging::set_sink(sink);
+
+    for (int i = 0; i < 10000; ++i) {
+        LOG_SAMPLED(LogLevel::INFO, 0.1, "chance {}", i);
+    }
+    // 期望 1000 条, 标准差 30 左右
+    const size_t passed = sink->count("chance");
+    EXPECT_GE(passed, 800U);
+    EXPECT_LE(passed, 1200U);
+    logging::flush();
+    EXPECT_EQ(sink->suppressed(), 10000U - passed);
+
+    for (int i = 0; i < 100; ++i) {
+        LOG_SAMPLED(LogLevel::INFO, 1.0, "always {}", i);
+        LOG_SAMPLED(LogLevel::INFO, 0.0, "never {}", i);
+    }
+    EXPECT_EQ(sink->count("always"), 100U);
+    EXPECT_EQ(sink->count("never"), 0U);
+    logging::flush();
+    EXPECT_EQ(sink->suppressed(), 10000U - passed + 100U);
+
+    logging::set_sink(nullptr);
+}
+
+// 和 stop_async 并发写的日志要么进了最后一次 drain, 要么改走同步, 一条都不能丢
+TEST(log, stop_race) {
+    auto sink = std::make_shared<CaptureSink>();
+    logging::set_sink(sink);
+    constexpr int kRounds = 20;
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 200;
+    for (int round = 0; round < kRounds; ++round) {
+        logging::AsyncOptions opts;
+        opts.deferred = round % 2 == 1;
+        logging::start_async(opts);
+        std::atomic<int> started{0};
+        std::vector<std::thread> threads;
+        threads.reserve(kThreads);
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([round, t, &started] -> void {
+                started.fetch_add(1);
+                for (int i = 0; i < kRecords; ++i) {
+                    INFO("stop race {} {} {}", round, t, i);
+                }
+            });
+        }
+        // 所有线程都开始写了再停, 让 stop 落在写的过程中
+        while (started.load() < kThreads) {
+            std::this_thread::yield();
+        }
+        logging::stop_async();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    logging::set_sink(nullptr);
+    EXPECT_EQ(sink->count("stop race"), static_cast<size_t>(kRounds * kThreads * kRecords));
+}
+
+TEST(log, json) {
+    auto sink = std::make_shared<CaptureSink>();
+    logging::set_sink(sink);
+    logging::set_format(logging::Format::JSON);
+
+    std::string user = "alice \"a\"";
+    LOG_KV(
+        LogLevel::WARN,
+        logging::fields("user", user, "attempt", 3, "cost_ms", 1.5, "ok", false),
+        "login {}",
+        "failed");
+    logging::set_format(logging::Format::TEXT);
+    LOG_KV(LogLevel::INFO, logging::fields("user", user, "attempt", 4U), "login ok");
+    logging::set_sink(nullptr);
+
+    const auto newline = sink->text.find('\n');
+    ASSERT_NE(newline, std::string::npos);
+    rapidjson::Document doc;
+    doc.Parse(sink->text.data(), newline);
+    ASSERT_FALSE(doc.HasParseError());
+    EXPECT_STREQ(doc["level"].GetString(), "WARN");
+    EXPECT_STREQ(doc["message"].GetString(), "login failed");
+    EXPECT_NE(std::string_view(doc["file"].GetString()).find("log_test.cc"), std::string::npos);
+    EXPECT_GT(doc["line"].GetUint(), 0U);
+    EXPECT_EQ(std::string_view(doc["ts"].GetString()).size(), 27U);
+    EXPECT_STREQ(doc["fields"]["user"].GetString(), "alice \"a\"");
+    EXPECT_EQ(doc["fields"]["attempt"].GetInt64(), 3);
+    EXPECT_DOUBLE_EQ(doc["fields"]["cost_ms"].GetDouble(), 1.5);
+    EXPECT_FALSE(doc["fields"]["ok"].GetBool());
+
+    EXPECT_NE(sink->text.find("login ok user=alice \"a\" attempt=4\n"), std::string::npos);
+}
@@ -12,7 +12,6 @@
 #include "cpuinfo.h"
 #include "gflags/gflags.h"
 #include "gtest/gtest.h"
-#include "lib/cmd.h"
 #include "lib/log.h"
 #include "lib/meta.h"
 
@@ -37,6 +36,8 @@ void log_env(char** envp) {
 
 auto main(int argc, char** argv, char** envp) -> int {
     absl::Time start = absl::Now();
+    // 环境信息在后台采集, 与下面的初始化并行
+    EnvInfo::prefetch();
 
 #ifdef __GLIBCXX__
     std::clog << "__GLIBCXX__:" << __GLIBCXX__ << '\n';
@@ -51,17 +52,6 @@ auto main(int argc, char** argv, char** envp) -> int {
         INFO("{} is exit, cost {}", getpid(), absl::FormatDuration(elapsed));
     });
 
-    INFO("\n{}", exec_cmd({"uname", "-a"}));
-
-#ifdef __linux__
-    INFO("\n{}", exec_cmd({"ldd", "--version"}));
-    INFO("\n{}", exec_cmd({"gcc", "--version"}));
-    INFO("\n{}", exec_cmd({"lscpu"}));
-    INFO("\n{}", exec_cmd({"cat", "/proc/version"}));
-    INFO("\n{}", exec_cmd({"cat", "/proc/cpuinfo"}));
-    INFO("\n{}", exec_cmd({"cat", "/proc/meminfo"}));
-#endif
-
     testing::InitGoogleTest(&argc, argv);
     gflags::ParseCommandLineFlags(&argc, &argv, false);
     absl::InitializeLog();
@@ -69,9 +59,9 @@ auto main(int argc, char** argv, char** envp) -> int {
     absl::SetStderrThreshold(absl::LogSeverityAtLeast::kInfo);
     log_env(envp);
 
-    EnvInfo info;
-
-    INFO("env info. {}", info.toStr());
+    INFO("env info. {}", EnvInfo::get().toStr());
+    INFO("cpu info. {}", CpuInfo::get());
+    INFO("startup cost {}", absl::FormatDuration(absl::Now() - start));
 
     return RUN_ALL_TESTS();
 }
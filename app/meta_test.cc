@@ -1,9 +1,21 @@
 #include "lib/meta.h"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <csignal>
 #include <format>
+#include <future>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "absl/cleanup/cleanup.h"
+#include "cpuinfo.h"
 #include "gtest/gtest.h"
+#include "lib/cmd.h"
 #include "lib/log.h"
 
 TEST(meta, cpu) {
@@ -14,4 +26,162 @@ TEST(meta, cpu) {
 TEST(meta, defer) {
     const absl::Cleanup done = std::function<void()>([]() -> void { INFO("run in cleanup"); });
     INFO("run {}", __PRETTY_FUNCTION__);
-}
\ No newline at end of file
+}
+TEST(meta, topology) {
+    const auto& topology = CpuTopology::get();
+    ASSERT_FALSE(topology.processors().empty());
+
+    const auto cores = topology.cores();
+    EXPECT_EQ(cores.size(), cpuinfo_get_cores_count());
+    EXPECT_FALSE(topology.l3_domains().empty());
+
+    const uint32_t cpu = topology.processors().front().cpu;
+    const auto siblings = topology.smt_siblings(cpu);
+    EXPECT_NE(std::ranges::find(siblings, cpu), siblings.end());
+
+    // 容器里 cpuset 可能受限, plan 只用允许运行的 CPU
+    const CpuSet allowed = allowed_cpus();
+    ASSERT_FALSE(allowed.empty());
+    EXPECT_TRUE(std::ranges::is_sorted(allowed));
+    std::set<uint32_t> allowed_cores;
+    for (const auto& p : topology.processors()) {
+        if (std::ranges::binary_search(allowed, p.cpu)) {
+            allowed_cores.insert(p.core);
+        }
+    }
+
+    // 每个可用的物理核一个线程, 互不共享 SMT, 并且都能绑定成功
+    const auto plan = topology.plan(allowed_cores.size(), Placement::CORE);
+    ASSERT_EQ(plan.size(), allowed_cores.size());
+    std::set<uint32_t> used;
+    for (const auto& cpus : plan) {
+        ASSERT_EQ(cpus.size(), 1U);
+        EXPECT_TRUE(std::ranges::binary_search(allowed, cpus.front()));
+        for (uint32_t sibling : topology.smt_siblings(cpus.front())) {
+            EXPECT_TRUE(used.insert(sibling).second);
+        }
+        std::thread t([&cpus] -> void { EXPECT_TRUE(pin_current_thread(cpus)); });
+        t.join();
+    }
+
+    for (const auto& cpus : topology.plan(2, Placement::L3)) {
+        for (uint32_t cpu : cpus) {
+            EXPECT_TRUE(std::ranges::binary_search(allowed, cpu));
+        }
+    }
+}
+
+TEST(meta, cache) {
+    const auto& cpu = CpuInfo::get();
+    if (cpu.l1.count > 0) {
+        EXPECT_GT(cpu.l1.size, 0U);
+        EXPECT_GT(cpu.l1.line_size, 0U);
+        EXPECT_GT(cpu.l1.shared, 0U);
+    }
+    if (cpu.l2.count > 0 && cpu.l1.count > 0) {
+        EXPECT_GE(cpu.l2.size, cpu.l1.size);
+    }
+
+    const size_t chunk = tuning::compress_chunk_size();
+    EXPECT_TRUE(std::has_single_bit(chunk));
+    EXPECT_GE(chunk, 64U << 10);
+
+    const size_t batch = tuning::hash_batch_size(64);
+    EXPECT_TRUE(std::has_single_bit(batch));
+    EXPECT_LE(batch * 64, std::max<size_t>(cpu.l1.size, 32U << 10));
+
+    EXPECT_GE(tuning::arena_block_size(), 4096U);
+}
+
+TEST(meta, env) {
+    EnvInfo::prefetch();
+    const auto& env = EnvInfo::get();
+    EXPECT_EQ(&env, &EnvInfo::get());
+    EXPECT_EQ(env.pid, getpid());
+    EXPECT_FALSE(env.sysname.empty());
+#ifdef __linux__
+    EXPECT_FALSE(env.kernel.empty());
+    EXPECT_GT(env.mem_info.total, 0U);
+    EXPECT_LE(env.mem_info.available, env.mem_info.total);
+#endif
+    INFO("env {}", env.toStr());
+}
+
+TEST(meta, resource_sampler) {
+    ResourceSampler::Options opts;
+    opts.interval = std::chrono::milliseconds(10);
+    opts.capacity = 8;
+    ResourceSampler sampler(opts);
+    sampler.start();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // 触发缺页, 让 rss 和 minor_faults 有变化
+    std::vector<char> pages(8U << 20, 1);
+    const auto now = sampler.sample();
+    sampler.stop();
+
+    EXPECT_GT(now.rss, pages.size());
+    EXPECT_GT(now.fds, 0U);
+    EXPECT_FALSE(now.threads.empty());
+
+    const auto history = sampler.history();
+    ASSERT_GE(history.size(), 2U);
+    EXPECT_LE(history.size(), opts.capacity);
+    EXPECT_TRUE(std::ranges::is_sorted(history, {}, &ResourceSample::at));
+
+    const auto delta = sampler.delta(std::chrono::seconds(10));
+    EXPECT_GT(delta.minor_faults, 0U);
+    INFO(
+        "rss={}MB faults={} vcsw={} ivcsw={} threads={}",
+        delta.rss >> 20U,
+        delta.minor_faults,
+        delta.voluntary_switches,
+        delta.involuntary_switches,
+        delta.threads.size());
+}
+
+TEST(cmd, run) {
+    auto result = run_cmd({"sh", "-c", "echo out; echo err >&2; exit 3"});
+    EXPECT_FALSE(result.error);
+    EXPECT_FALSE(result.timed_out);
+    EXPECT_EQ(result.status, 3);
+    EXPECT_EQ(result.signal, 0);
+    EXPECT_EQ(result.out, "out\n");
+    EXPECT_EQ(result.err, "err\n");
+
+    std::string streamed;
+    CmdOptions opts;
+    opts.on_stdout = [&streamed](std::string_view chunk) -> void { streamed.append(chunk); };
+    result = run_cmd({"sh", "-c", "seq 1 1000"}, opts);
+    EXPECT_TRUE(result.out.empty());
+    EXPECT_TRUE(streamed.starts_with("1\n2\n"));
+    EXPECT_TRUE(streamed.ends_with("1000\n"));
+}
+
+TEST(cmd, timeout) {
+    CmdOptions opts;
+    opts.timeout = std::chrono::milliseconds(100);
+    opts.grace = std::chrono::milliseconds(100);
+
+    const auto begin = std::chrono::steady_clock::now();
+    // 忽略 SIGTERM, 必须升级到 SIGKILL
+    auto result = run_cmd({"sh", "-c", "trap '' TERM; exec sleep 30"}, opts);
+    EXPECT_TRUE(result.timed_out);
+    EXPECT_EQ(result.signal, SIGKILL);
+    EXPECT_EQ(result.status, 128 + SIGKILL);
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+}
+
+TEST(cmd, pool) {
+    CmdPool pool(4);
+    std::vector<std::future<CmdResult>> results;
+    results.reserve(16);
+    for (int i = 0; i < 16; ++i) {
+        results.push_back(pool.submit({"sh", "-c", std::format("echo {}", i)}));
+    }
+    for (int i = 0; i < 16; ++i) {
+        auto result = results[i].get();
+        EXPECT_EQ(result.status, 0);
+        EXPECT_EQ(result.out, std::format("{}\n", i));
+    }
+}
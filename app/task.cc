@@ -1,12 +1,19 @@
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
+
+#include <sched.h>
 
 #include "absl/synchronization/notification.h"
 #include "exec/static_thread_pool.hpp"
 #include "gtest/gtest.h"
 #include "lib/log.h"
+#include "lib/meta.h"
 #include "stdexec/execution.hpp"
 
 class BgTaskStd {
@@ -71,6 +78,9 @@ public:
         }
 
         t_ = std::thread([this]() -> void {
+            if (!cpus_.empty() && !pin_current_thread(cpus_)) {
+                WARN("{} pin to {} cpus failed", name_, cpus_.size());
+            }
             INFO("{} task thread started", name_);
             while (!notify_.WaitForNotificationWithTimeout(interval_)) {
                 run();
@@ -79,6 +89,9 @@ public:
         });
     }
 
+    // 在 start() 之前调用, 线程启动后先把自己绑定到 cpus
+    void pin(CpuSet cpus) { cpus_ = std::move(cpus); }
+
     // 显式停止：建议在子类析构函数的第一行调用 Stop()
     void stop() {
         if (!notify_.HasBeenNotified()) {
@@ -98,6 +111,7 @@ protected:
 private:
     std::thread t_;
     absl::Duration interval_;
+    CpuSet cpus_;
 };
 
 class MockBgTask : public BgWithAbsl {
@@ -157,4 +171,28 @@ TEST(exec, exec) {
 
     auto [i, j, k] = stdexec::sync_wait(work).value();
     INFO("i = {} j = {} k = {}", i, j, k);
-}
\ No newline at end of file
+}
+
+TEST(exec, pinned_pool) {
+    const auto& topology = CpuTopology::get();
+    const uint32_t threads = 2;
+    exec::static_thread_pool pool(threads);
+
+    // plan 只用允许运行的 CPU, 容器里 cpuset 受限时也能全部绑定成功
+    const auto plan = topology.plan(threads, Placement::CORE);
+    ASSERT_EQ(plan.size(), threads);
+    EXPECT_TRUE(pin_workers(threads, plan, [&pool](std::function<void()> fn) -> void {
+        stdexec::start_detached(
+            stdexec::schedule(pool.get_scheduler()) | stdexec::then(std::move(fn)));
+    }));
+    CpuSet cpus;
+    for (const auto& set : plan) {
+        cpus.insert(cpus.end(), set.begin(), set.end());
+    }
+
+    auto cpu_of_worker = [] -> int { return sched_getcpu(); };
+    auto work =
+        stdexec::starts_on(pool.get_scheduler(), stdexec::just() | stdexec::then(cpu_of_worker));
+    auto [cpu] = stdexec::sync_wait(std::move(work)).value();
+    EXPECT_NE(std::ranges::find(cpus, static_cast<uint32_t>(cpu)), cpus.end());
+}
@@ -1,7 +1,10 @@
+#include <algorithm>
+#include <cstddef>
 #include <memory>
 
 #include "benchmark/benchmark.h"
 #include "google/protobuf/arena.h"
+#include "lib/meta.h"
 #include "lib/parameter.pb.h"
 
 void without_arean(std::shared_ptr<idl::Parameter> param) {
@@ -58,9 +61,12 @@ static void BM_without_arean(benchmark::State& state) {
     }
 }
 
+// range(0) 为 0 时按 L2 容量自动选择块大小, 否则使用给定的字节数
 static void BM_with_arean(benchmark::State& state) {
     google::protobuf::ArenaOptions opt;
-    opt.initial_block_size = 4096;
+    opt.initial_block_size = state.range(0) > 0 ? static_cast<size_t>(state.range(0))
+                                                : tuning::arena_block_size();
+    opt.max_block_size = std::max(opt.max_block_size, opt.initial_block_size);
     google::protobuf::Arena arena(opt);
     for (auto _ : state) {
         auto* param = google::protobuf::Arena::Create<idl::Parameter>(&arena);
@@ -70,4 +76,4 @@ static void BM_with_arean(benchmark::State& state) {
 }
 
 BENCHMARK(BM_without_arean);
-BENCHMARK(BM_with_arean);
\ No newline at end of file
+BENCHMARK(BM_with_arean)->Arg(4096)->Arg(0);
\ No newline at end of file
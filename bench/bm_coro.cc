@@ -0,0 +1,129 @@
+#include <functional>
+#include <utility>
+
+#include "benchmark/benchmark.h"
+#include "lib/coro.h"
+#include "stdexec/execution.hpp"
+#include "taskflow/taskflow.hpp"
+
+// 对比同样深度的调用链在几种异步写法下的开销:
+// Task<T> 协程 / std::function 回调 / stdexec then / taskflow 任务图
+
+namespace {
+
+auto leaf(int v) -> Task<int> {
+    co_return v + 1;
+}
+
+auto task_chain(int depth, int v) -> Task<int> {
+    if (depth <= 1) {
+        co_return co_await leaf(v);
+    }
+    int r = co_await task_chain(depth - 1, v);
+    co_return r + 1;
+}
+
+void callback_chain(int depth, int v, const std::function<void(int)>& cb) {
+    if (depth <= 1) {
+        cb(v + 1);
+        return;
+    }
+    callback_chain(depth - 1, v, [&cb](int r) -> void { cb(r + 1); });
+}
+
+template <int N, typename S>
+auto then_chain(S&& sndr) {
+    if constexpr (N == 0) {
+        return std::forward<S>(sndr);
+    } else {
+        return then_chain<N - 1>(
+            std::forward<S>(sndr) | stdexec::then([](int v) -> int { return v + 1; }));
+    }
+}
+
+}  // namespace
+
+static void BM_TaskCreateDestroy(benchmark::State& state) {
+    for (auto _ : state) {
+        auto task = leaf(1);
+        benchmark::DoNotOptimize(task);
+    }
+}
+
+static void BM_TaskResume(benchmark::State& state) {
+    for (auto _ : state) {
+        auto task = leaf(1);
+        task.resume();
+        benchmark::DoNotOptimize(task.get_result());
+    }
+}
+
+static void BM_TaskChain(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        auto task = task_chain(depth, 0);
+        task.resume();
+        benchmark::DoNotOptimize(task.get_result());
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+}
+
+static void BM_TaskChainSyncWait(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        auto [r] = stdexec::sync_wait(task_chain(depth, 0)).value();
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+}
+
+static void BM_CallbackChain(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        int result = 0;
+        callback_chain(depth, 0, [&result](int r) -> void { result = r; });
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+}
+
+template <int N>
+static void BM_StdexecThenChain(benchmark::State& state) {
+    for (auto _ : state) {
+        auto [r] = stdexec::sync_wait(then_chain<N>(stdexec::just(0))).value();
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_TaskflowChain(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    tf::Executor executor(1);
+    // 图只建一次, 计时循环里只测调度执行
+    int result = 0;
+    tf::Taskflow taskflow;
+    tf::Task prev;
+    for (int i = 0; i < depth; ++i) {
+        auto cur = taskflow.emplace([&result]() -> void { ++result; });
+        if (!prev.empty()) {
+            prev.precede(cur);
+        }
+        prev = cur;
+    }
+    for (auto _ : state) {
+        result = 0;
+        executor.run(taskflow).wait();
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+}
+
+BENCHMARK(BM_TaskCreateDestroy);
+BENCHMARK(BM_TaskResume);
+BENCHMARK(BM_TaskChain)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_TaskChainSyncWait)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_CallbackChain)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK_TEMPLATE(BM_StdexecThenChain, 1);
+BENCHMARK_TEMPLATE(BM_StdexecThenChain, 8);
+BENCHMARK_TEMPLATE(BM_StdexecThenChain, 32);
+BENCHMARK(BM_TaskflowChain)->Arg(1)->Arg(8)->Arg(32);
@@ -1,11 +1,14 @@
 #include <cstdint>
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "benchmark/benchmark.h"
+#include "lib/json.h"
 #include "rapidjson/document.h"
 #include "rapidjson/pointer.h"
+#include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
@@ -18,12 +21,14 @@ struct Item {
     std::vector<int64_t> spuids = {1001, 1002, 1003, 1004, 1005};
     std::unordered_map<std::string, std::string> strs = {{"key1", "val1"}, {"key2", "val2"}};
     std::unordered_map<std::string, double> dbls = {{"metric1", 0.5}, {"metric2", 1.5}};
+
+    JSON_FIELDS(Item, id, score, coef, offline, brand, spuids, strs, dbls)
 };
 
-void item_to_json_by_doc(const Item& item, std::string& dst) {
-    rapidjson::Document doc;
-    doc.SetObject();
+// 序列化的几种写法, 各有两个版本: 每次新建 Document / StringBuffer 再拷贝到 dst,
+// 或者 _pooled: 复用线程内 json::Context 的内存池和 Writer, 直接写进 dst
 
+void fill_doc(const Item& item, rapidjson::Document& doc) {
     auto& allocator = doc.GetAllocator();
     doc.AddMember("id", item.id, allocator);
     doc.AddMember("score", item.score, allocator);
@@ -52,6 +57,12 @@ void item_to_json_by_doc(const Item& item, std::string& dst) {
         dbl_val.AddMember(rapidjson::StringRef(k.data()), v, allocator);
     }
     doc.AddMember("dbls", dbl_val, allocator);
+}
+
+void item_to_json_by_doc(const Item& item, std::string& dst) {
+    rapidjson::Document doc;
+    doc.SetObject();
+    fill_doc(item, doc);
 
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -59,9 +70,17 @@ void item_to_json_by_doc(const Item& item, std::string& dst) {
     dst.assign(buffer.GetString(), buffer.GetSize());
 }
 
-void item_to_json_by_sax(const Item& item, std::string& dst) {
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+void item_to_json_by_doc_pooled(const Item& item, std::string& dst) {
+    auto& ctx = json::Context::local();
+    auto& doc = ctx.document();
+    fill_doc(item, doc);
+
+    dst.clear();
+    doc.Accept(ctx.writer(dst));
+}
+
+template <typename Writer>
+void write_sax(const Item& item, Writer& writer) {
     writer.StartObject();
     writer.Key("id");
     writer.Int64(item.id);
@@ -98,14 +117,21 @@ void item_to_json_by_sax(const Item& item, std::string& dst) {
     writer.EndObject();
 
     writer.EndObject();
+}
 
+void item_to_json_by_sax(const Item& item, std::string& dst) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    write_sax(item, writer);
     dst.assign(buffer.GetString(), buffer.GetSize());
 }
 
-void item_to_json_by_pointer(const Item& item, std::string& dst) {
-    rapidjson::Document d;
-    d.SetObject();
+void item_to_json_by_sax_pooled(const Item& item, std::string& dst) {
+    dst.clear();
+    write_sax(item, json::Context::local().writer(dst));
+}
 
+void fill_by_pointer(const Item& item, rapidjson::Document& d) {
     // Basic types using Pointer::Set
     rapidjson::Pointer("/id").Set(d, item.id);
     rapidjson::Pointer("/score").Set(d, item.score);
@@ -129,6 +155,12 @@ void item_to_json_by_pointer(const Item& item, std::string& dst) {
         std::string path = "/dbls/" + k;
         rapidjson::Pointer(path.c_str()).Set(d, v);
     }
+}
+
+void item_to_json_by_pointer(const Item& item, std::string& dst) {
+    rapidjson::Document d;
+    d.SetObject();
+    fill_by_pointer(item, d);
 
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -136,36 +168,223 @@ void item_to_json_by_pointer(const Item& item, std::string& dst) {
     dst.assign(buffer.GetString(), buffer.GetSize());
 }
 
-static void BM_JsonByDom(benchmark::State& state) {
+// 同样的写法, Pointer 从 json::pointer 的缓存里取, 拼 path 的字符串也复用
+void fill_by_cached_pointer(const Item& item, rapidjson::Document& d) {
+    json::pointer("/id")->Set(d, item.id);
+    json::pointer("/score")->Set(d, item.score);
+    json::pointer("/coef")->Set(d, static_cast<double>(item.coef));
+    json::pointer("/offline")->Set(d, item.offline);
+    json::pointer("/brand")->Set(d, item.brand.c_str(), d.GetAllocator());
+
+    rapidjson::Value spuids(rapidjson::kArrayType);
+    for (auto s : item.spuids) {
+        spuids.PushBack(s, d.GetAllocator());
+    }
+    json::pointer("/spuids")->Set(d, spuids);
+
+    thread_local std::string path;
+    for (const auto& [k, v] : item.strs) {
+        path.assign("/strs/").append(k);
+        json::pointer(path)->Set(d, v.c_str(), d.GetAllocator());
+    }
+    for (const auto& [k, v] : item.dbls) {
+        path.assign("/dbls/").append(k);
+        json::pointer(path)->Set(d, v);
+    }
+}
+
+void item_to_json_by_pointer_pooled(const Item& item, std::string& dst) {
+    auto& ctx = json::Context::local();
+    auto& d = ctx.document();
+    fill_by_cached_pointer(item, d);
+
+    dst.clear();
+    d.Accept(ctx.writer(dst));
+}
+
+// 和 item_to_json_by_sax 输出一致, 由 JSON_FIELDS 生成 Writer 调用, 本身就复用 Context
+void item_to_json_by_reflect(const Item& item, std::string& dst) {
+    dst.clear();
+    json::to_json(item, dst);
+}
+
+using ToJson = void (*)(const Item&, std::string&);
+
+// range(0): 0 每次新建 dst, 1 dst 在循环外复用, 配合 _pooled 版本稳定后不再分配
+void run_to_json(benchmark::State& state, ToJson fresh, ToJson pooled) {
     Item item;
-    for (auto _ : state) {
+    if (state.range(0) == 0) {
+        for (auto _ : state) {
+            std::string dst;
+            fresh(item, dst);
+            benchmark::DoNotOptimize(dst);
+        }
+    } else {
         std::string dst;
-        item_to_json_by_doc(item, dst);
-        benchmark::DoNotOptimize(dst);
+        for (auto _ : state) {
+            pooled(item, dst);
+            benchmark::DoNotOptimize(dst);
+        }
     }
 }
 
+static void BM_JsonByDom(benchmark::State& state) {
+    run_to_json(state, item_to_json_by_doc, item_to_json_by_doc_pooled);
+}
+
 static void BM_JsonByPointer(benchmark::State& state) {
-    Item item;
+    run_to_json(state, item_to_json_by_pointer, item_to_json_by_pointer_pooled);
+}
+
+static void BM_JsonBySax(benchmark::State& state) {
+    run_to_json(state, item_to_json_by_sax, item_to_json_by_sax_pooled);
+}
+
+static void BM_JsonByReflect(benchmark::State& state) {
+    run_to_json(state, item_to_json_by_reflect, item_to_json_by_reflect);
+}
+
+// 反序列化: DOM 解析后逐字段读取 vs 按 JSON_FIELDS 单趟 SAX
+auto item_from_json_by_dom(const std::string& src, Item& item) -> bool {
+    rapidjson::Document doc;
+    doc.Parse(src.data(), src.size());
+    if (doc.HasParseError() || !doc.IsObject()) {
+        return false;
+    }
+    item.id = doc["id"].GetInt64();
+    item.score = doc["score"].GetDouble();
+    item.coef = static_cast<float>(doc["coef"].GetDouble());
+    item.offline = doc["offline"].GetBool();
+    item.brand.assign(doc["brand"].GetString(), doc["brand"].GetStringLength());
+    item.spuids.clear();
+    for (const auto& v : doc["spuids"].GetArray()) {
+        item.spuids.push_back(v.GetInt64());
+    }
+    item.strs.clear();
+    for (const auto& m : doc["strs"].GetObject()) {
+        item.strs.emplace(m.name.GetString(), m.value.GetString());
+    }
+    item.dbls.clear();
+    for (const auto& m : doc["dbls"].GetObject()) {
+        item.dbls.emplace(m.name.GetString(), m.value.GetDouble());
+    }
+    return true;
+}
+
+static void BM_JsonParseByDom(benchmark::State& state) {
+    const std::string src = json::to_json(Item{});
     for (auto _ : state) {
-        std::string dst;
-        item_to_json_by_pointer(item, dst);
-        benchmark::DoNotOptimize(dst);
+        Item item;
+        benchmark::DoNotOptimize(item_from_json_by_dom(src, item));
+        benchmark::DoNotOptimize(item);
     }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
 }
 
-static void BM_JsonBySax(benchmark::State& state) {
-    Item item;
+static void BM_JsonParseBySchema(benchmark::State& state) {
+    const std::string src = json::to_json(Item{});
     for (auto _ : state) {
-        std::string dst;
-        item_to_json_by_sax(item, dst);
-        benchmark::DoNotOptimize(dst);
+        Item item;
+        benchmark::DoNotOptimize(json::from_json(src, item));
+        benchmark::DoNotOptimize(item);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
+}
+
+// 原地解析: 每轮先把输入拷进可写的 buffer (容量复用), 字符串不再经过 Reader 的栈
+static void BM_JsonParseBySchemaInsitu(benchmark::State& state) {
+    const std::string src = json::to_json(Item{});
+    std::string buffer;
+    for (auto _ : state) {
+        buffer.assign(src);
+        Item item;
+        benchmark::DoNotOptimize(json::from_json_insitu(buffer, item));
+        benchmark::DoNotOptimize(item);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
+}
+
+// SIMD 快速路径: range(0) 为 0 时关掉 (标量扫描, 数组逐 token 经 Reader 回调), 1 时打开.
+// label 是运行时选中的实现
+struct Payload {
+    std::vector<int64_t> spuids;
+    std::vector<double> scores;
+    std::vector<std::string> tags;
+
+    JSON_FIELDS(Payload, spuids, scores, tags)
+};
+
+// 1000 个商品 id, 1000 个分数, 200 个带转义的标签; pretty 为 true 时带缩进和换行
+auto make_payload(bool pretty) -> std::string {
+    std::mt19937_64 rng(42);
+    Payload payload;
+    for (int i = 0; i < 1000; ++i) {
+        payload.spuids.push_back(static_cast<int64_t>(rng() >> 12U));
+        payload.scores.push_back(static_cast<double>(rng() % 1000000) / 1000.0);
+    }
+    for (int i = 0; i < 200; ++i) {
+        payload.tags.push_back("category/brand-" + std::to_string(rng() % 100000) +
+                               " \"promotion\" tag with some descriptive text");
+    }
+    std::string compact = json::to_json(payload);
+    if (!pretty) {
+        return compact;
+    }
+    rapidjson::Document doc;
+    doc.Parse(compact.data(), compact.size());
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    doc.Accept(writer);
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
+static void BM_JsonParseArrays(benchmark::State& state) {
+    json::set_fast_paths(state.range(0) != 0);
+    const std::string src = make_payload(state.range(1) != 0);
+    Payload payload;
+    // 浮点数组只在 kParseFullPrecisionFlag 下走快速路径, 两组都带上它才是同一个语义
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(json::from_json<rapidjson::kParseFullPrecisionFlag>(src, payload));
+        benchmark::DoNotOptimize(payload);
+    }
+    json::set_fast_paths(true);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(src.size()));
+    state.SetLabel(std::string(json::simd_name()));
+}
+
+// 单独看扫描内核: 64K 没有特殊字符的字符串 / 空白
+static void BM_JsonScanString(benchmark::State& state) {
+    json::set_fast_paths(state.range(0) != 0);
+    const std::string text(64U << 10, 'a');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(json::detail::scan_string(text.data(), text.data() + text.size()));
+    }
+    json::set_fast_paths(true);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+    state.SetLabel(std::string(json::simd_name()));
+}
+
+static void BM_JsonSkipSpace(benchmark::State& state) {
+    json::set_fast_paths(state.range(0) != 0);
+    const std::string text(64U << 10, ' ');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(json::detail::skip_space(text.data(), text.data() + text.size()));
     }
+    json::set_fast_paths(true);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+    state.SetLabel(std::string(json::simd_name()));
 }
 
-BENCHMARK(BM_JsonByDom);
-BENCHMARK(BM_JsonByPointer);
-BENCHMARK(BM_JsonBySax);
+BENCHMARK(BM_JsonByDom)->ArgName("pooled")->Arg(0)->Arg(1);
+BENCHMARK(BM_JsonByPointer)->ArgName("pooled")->Arg(0)->Arg(1);
+BENCHMARK(BM_JsonBySax)->ArgName("pooled")->Arg(0)->Arg(1);
+BENCHMARK(BM_JsonByReflect)->ArgName("pooled")->Arg(0)->Arg(1);
+BENCHMARK(BM_JsonParseByDom);
+BENCHMARK(BM_JsonParseBySchema);
+BENCHMARK(BM_JsonParseBySchemaInsitu);
+BENCHMARK(BM_JsonParseArrays)->ArgNames({"simd", "pretty"})->ArgsProduct({{0, 1}, {0, 1}});
+BENCHMARK(BM_JsonScanString)->ArgName("simd")->Arg(0)->Arg(1);
+BENCHMARK(BM_JsonSkipSpace)->ArgName("simd")->Arg(0)->Arg(1);
 
 auto main(int argc, char** argv) -> int {
     benchmark::MaybeReenterWithoutASLR(argc, argv);
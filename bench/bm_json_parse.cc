@@ -0,0 +1,393 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lib/json.h"
+#include "lib/jsonl.h"
+#include "rapidjson/document.h"
+#include "rapidjson/reader.h"
+
+// 解析相关的 benchmark. range(0) 选语料:
+//   0 flat: 小而平的对象, 1024 个不同的文档轮流解析
+//   1 nested: 32 层嵌套的对象和数组
+//   2 numbers: 一万个整数 + 一万个浮点数的大数组
+//   3 strings: 一万个字符串的大数组, 部分带转义
+// 每轮解析一个文档, 报告 bytes/s, 文档数/s 和每个文档的平均分配次数
+
+// 分配计数对整个进程生效, 所以这个 suite 单独编成 //bench:bench_json_parse.
+// 每次分配只多一次线程局部自增
+namespace {
+thread_local uint64_t t_allocs = 0;
+} // namespace
+
+#if defined(__GLIBC__)
+// glibc 支持替换 malloc 一族, 转发给 __libc_*. rapidjson 的 CrtAllocator 直接调 malloc,
+// 只换 operator new 会漏掉它
+// NOLINTBEGIN(bugprone-reserved-identifier)
+extern "C" {
+auto __libc_malloc(size_t size) -> void*;
+auto __libc_calloc(size_t n, size_t size) -> void*;
+auto __libc_realloc(void* ptr, size_t size) -> void*;
+void __libc_free(void* ptr);
+
+auto malloc(size_t size) noexcept -> void* {
+    ++t_allocs;
+    return __libc_malloc(size);
+}
+
+auto calloc(size_t n, size_t size) noexcept -> void* {
+    ++t_allocs;
+    return __libc_calloc(n, size);
+}
+
+auto realloc(void* ptr, size_t size) noexcept -> void* {
+    ++t_allocs;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) noexcept {
+    __libc_free(ptr);
+}
+}
+// NOLINTEND(bugprone-reserved-identifier)
+#else
+auto operator new(size_t size) -> void* {
+    ++t_allocs;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+#endif
+
+namespace {
+
+struct Flat {
+    int64_t id = 0;
+    double score = 0;
+    float coef = 0;
+    bool enable = false;
+    int32_t boost = 0;
+    uint64_t ts = 0;
+    double price = 0;
+    int64_t stock = 0;
+    std::string name;
+    std::string brand;
+    std::string category;
+    std::string url;
+
+    JSON_FIELDS(Flat, id, score, coef, enable, boost, ts, price, stock, name, brand, category, url)
+};
+
+struct Node {
+    int64_t id = 0;
+    std::string name;
+    double weight = 0;
+    std::vector<int64_t> refs;
+    std::vector<Node> children;
+
+    JSON_FIELDS(Node, id, name, weight, refs, children)
+};
+
+struct Numbers {
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+
+    JSON_FIELDS(Numbers, ints, doubles)
+};
+
+struct Strings {
+    std::vector<std::string> strs;
+
+    JSON_FIELDS(Strings, strs)
+};
+
+enum Kind : uint8_t { FLAT, NESTED, NUMBERS, STRINGS };
+
+constexpr size_t kNestedDepth = 32;
+
+struct Corpus {
+    std::vector<std::string> docs;
+    // pointer 提取时读取的路径
+    std::vector<std::string> paths;
+};
+
+auto random_string(std::mt19937_64& rng, size_t min_len, size_t max_len, bool escapes)
+    -> std::string {
+    static constexpr std::string_view kAlphabet
+        = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-./";
+    std::uniform_int_distribution<size_t> len(min_len, max_len);
+    std::uniform_int_distribution<size_t> pick(0, kAlphabet.size() - 1);
+    std::string s(len(rng), ' ');
+    for (auto& c : s) {
+        c = kAlphabet[pick(rng)];
+    }
+    if (escapes && !s.empty() && rng() % 4 == 0) {
+        // Writer 会把这些字符写成 \" \\ \n \t 转义
+        s[rng() % s.size()] = "\"\\\n\t"[rng() % 4];
+    }
+    return s;
+}
+
+auto make_node(std::mt19937_64& rng, size_t depth) -> Node {
+    Node node;
+    node.id = static_cast<int64_t>(rng() >> 1U);
+    node.name = random_string(rng, 4, 16, false);
+    node.weight = std::uniform_real_distribution<double>(0, 1)(rng);
+    node.refs = {static_cast<int64_t>(depth), static_cast<int64_t>(rng() % 1000)};
+    if (depth > 1) {
+        node.children.push_back(make_node(rng, depth - 1));
+    }
+    return node;
+}
+
+auto make_corpus(Kind kind) -> Corpus {
+    std::mt19937_64 rng(kind);
+    Corpus corpus;
+    switch (kind) {
+        case FLAT:
+            for (int i = 0; i < 1024; ++i) {
+                Flat flat;
+                flat.id = static_cast<int64_t>(rng() >> 1U);
+                flat.score = std::uniform_real_distribution<double>(0, 100)(rng);
+                flat.coef = static_cast<float>(flat.score / 7);
+                flat.enable = (rng() & 1U) != 0;
+                flat.boost = static_cast<int32_t>(rng() % 10);
+                flat.ts = 1700000000000ULL + rng() % 100000000;
+                flat.price = static_cast<double>(rng() % 100000) / 100;
+                flat.stock = static_cast<int64_t>(rng() % 5000);
+                flat.name = random_string(rng, 8, 32, true);
+                flat.brand = random_string(rng, 4, 16, false);
+                flat.category = random_string(rng, 4, 12, false);
+                flat.url = "https://example.com/item/" + std::to_string(flat.id);
+                corpus.docs.push_back(json::to_json(flat));
+            }
+            corpus.paths = {"/id", "/price", "/name", "/url"};
+            break;
+        case NESTED: {
+            for (int i = 0; i < 16; ++i) {
+                corpus.docs.push_back(json::to_json(make_node(rng, kNestedDepth)));
+            }
+            std::string deepest;
+            for (size_t i = 1; i < kNestedDepth; ++i) {
+                deepest += "/children/0";
+            }
+            corpus.paths = {"/id", "/children/0/children/0/name", deepest + "/weight"};
+            break;
+        }
+        case NUMBERS: {
+            Numbers numbers;
+            for (int i = 0; i < 10000; ++i) {
+                numbers.ints.push_back(static_cast<int64_t>(rng() >> (rng() % 64U)));
+                numbers.doubles.push_back(std::uniform_real_distribution<double>(-1e6, 1e6)(rng));
+            }
+            corpus.docs.push_back(json::to_json(numbers));
+            corpus.paths = {"/ints/0", "/ints/9999", "/doubles/5000"};
+            break;
+        }
+        case STRINGS: {
+            Strings strings;
+            for (int i = 0; i < 10000; ++i) {
+                strings.strs.push_back(random_string(rng, 4, 64, true));
+            }
+            corpus.docs.push_back(json::to_json(strings));
+            corpus.paths = {"/strs/0", "/strs/9999"};
+            break;
+        }
+    }
+    return corpus;
+}
+
+auto make_corpus_cached(Kind kind) -> const Corpus& {
+    static const std::array<Corpus, 4> corpora
+        = {make_corpus(FLAT), make_corpus(NESTED), make_corpus(NUMBERS), make_corpus(STRINGS)};
+    return corpora.at(kind);
+}
+
+auto corpus_of(const benchmark::State& state) -> const Corpus& {
+    return make_corpus_cached(static_cast<Kind>(state.range(0)));
+}
+
+void corpus_args(benchmark::internal::Benchmark* b) {
+    b->ArgName("corpus")->DenseRange(FLAT, STRINGS);
+}
+
+// 轮流解析语料里的文档, parse 返回 false 视为失败
+template <typename Fn>
+void run_parse(benchmark::State& state, Fn&& parse) {
+    const Corpus& corpus = corpus_of(state);
+    size_t next = 0;
+    int64_t bytes = 0;
+    uint64_t allocs = 0;
+    for (auto _ : state) {
+        const std::string& doc = corpus.docs[next];
+        next = next + 1 == corpus.docs.size() ? 0 : next + 1;
+
+        const uint64_t before = t_allocs;
+        if (!parse(doc, corpus)) {
+            state.SkipWithError("parse failed");
+            break;
+        }
+        allocs += t_allocs - before;
+        bytes += static_cast<int64_t>(doc.size());
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs_per_doc"]
+        = benchmark::Counter(static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+}
+
+} // namespace
+
+// 每个文档新建 Document
+static void BM_ParseDom(benchmark::State& state) {
+    run_parse(state, [](const std::string& doc, const Corpus& /*corpus*/) -> bool {
+        rapidjson::Document d;
+        d.Parse(doc.data(), doc.size());
+        benchmark::DoNotOptimize(d);
+        return !d.HasParseError();
+    });
+}
+
+// 只做词法分析, handler 什么都不做, 是解析速度的上限
+static void BM_ParseSax(benchmark::State& state) {
+    rapidjson::Reader reader;
+    run_parse(state, [&reader](const std::string& doc, const Corpus& /*corpus*/) -> bool {
+        rapidjson::BaseReaderHandler<> handler;
+        rapidjson::StringStream stream(doc.c_str());
+        return !reader.Parse(stream, handler).IsError();
+    });
+}
+
+// 拷贝到可写 buffer 后原地解析, 节点落在 json::Context 复用的内存池里
+static void BM_ParseInsitu(benchmark::State& state) {
+    std::string buffer;
+    run_parse(state, [&buffer](const std::string& doc, const Corpus& /*corpus*/) -> bool {
+        buffer.assign(doc);
+        auto& d = json::Context::local().parse_insitu(buffer);
+        benchmark::DoNotOptimize(d);
+        return !d.HasParseError();
+    });
+}
+
+// DOM 解析后按缓存的 Pointer 取几个字段
+static void BM_ParsePointer(benchmark::State& state) {
+    run_parse(state, [](const std::string& doc, const Corpus& corpus) -> bool {
+        rapidjson::Document d;
+        d.Parse(doc.data(), doc.size());
+        if (d.HasParseError()) {
+            return false;
+        }
+        for (const auto& path : corpus.paths) {
+            const rapidjson::Value* v = json::pointer(path)->Get(d);
+            if (v == nullptr) {
+                return false;
+            }
+            benchmark::DoNotOptimize(v);
+        }
+        return true;
+    });
+}
+
+template <typename T>
+void run_schema(benchmark::State& state) {
+    // 目标对象跨文档复用, 容器保留容量, 和常驻服务里的用法一致
+    T out;
+    run_parse(state, [&out](const std::string& doc, const Corpus& /*corpus*/) -> bool {
+        const bool ok = json::from_json(doc, out);
+        benchmark::DoNotOptimize(out);
+        return ok;
+    });
+}
+
+// 按 JSON_FIELDS 直接解析到结构体
+static void BM_ParseSchema(benchmark::State& state) {
+    switch (state.range(0)) {
+        case FLAT:
+            run_schema<Flat>(state);
+            break;
+        case NESTED:
+            run_schema<Node>(state);
+            break;
+        case NUMBERS:
+            run_schema<Numbers>(state);
+            break;
+        default:
+            run_schema<Strings>(state);
+            break;
+    }
+}
+
+// 约 64MB 的 JSON-lines 文件, 内容是 flat 语料反复拼接, 进程内只生成一次
+auto lines_file() -> const std::string& {
+    static const std::string path = [] -> std::string {
+        const auto file = std::filesystem::temp_directory_path() / "bm_json_lines.jsonl";
+        const Corpus& flat = make_corpus_cached(FLAT);
+        std::ofstream out(file, std::ios::trunc | std::ios::binary);
+        size_t written = 0;
+        while (written < (64U << 20)) {
+            for (const auto& doc : flat.docs) {
+                out << doc << '\n';
+                written += doc.size() + 1;
+            }
+        }
+        return file.string();
+    }();
+    return path;
+}
+
+// range(0) 是解析线程数, 看吞吐是否随核数增长
+static void BM_JsonLines(benchmark::State& state) {
+    const std::string& path = lines_file();
+    json::LinesOptions opts;
+    opts.threads = static_cast<size_t>(state.range(0));
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        const auto stats = json::read_lines<Flat>(
+            path,
+            [](size_t /*chunk*/, std::span<Flat> records) -> void {
+                benchmark::DoNotOptimize(records.data());
+            },
+            opts);
+        bytes += static_cast<int64_t>(stats.bytes);
+        state.counters["records"] = static_cast<double>(stats.records);
+    }
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_ParseDom)->Apply(corpus_args);
+BENCHMARK(BM_ParseSax)->Apply(corpus_args);
+BENCHMARK(BM_ParseInsitu)->Apply(corpus_args);
+BENCHMARK(BM_ParsePointer)->Apply(corpus_args);
+BENCHMARK(BM_ParseSchema)->Apply(corpus_args);
+BENCHMARK(BM_JsonLines)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+auto main(int argc, char** argv) -> int {
+    benchmark::MaybeReenterWithoutASLR(argc, argv);
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "benchmark/benchmark.h"
+#include "lib/log.h"
+#include "lib/log_sink.h"
+
+// 测 INFO(...) 本身的开销: 输出写 /dev/null 或滚动文件, 不经过终端.
+// range(0) 是模式: 0 同步, 1 异步, 2 异步 + 延迟格式化
+// range(1) 是 sink: 0 /dev/null, 1 滚动文件
+
+namespace {
+
+class DevNullSink final : public logging::Sink {
+public:
+    DevNullSink() : fd_(::open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+
+    DevNullSink(const DevNullSink&) = delete;
+    DevNullSink(DevNullSink&&) = delete;
+    auto operator=(const DevNullSink&) -> DevNullSink& = delete;
+    auto operator=(DevNullSink&&) -> DevNullSink& = delete;
+
+    ~DevNullSink() override { ::close(fd_); }
+
+    void write(std::string_view data) override {
+        benchmark::DoNotOptimize(::write(fd_, data.data(), data.size()));
+    }
+
+private:
+    int fd_;
+};
+
+const auto kBenchDir = std::filesystem::temp_directory_path() / "bm_log";
+
+std::shared_ptr<logging::Sink> g_sink;
+
+void setup(const benchmark::State& state) {
+    if (state.range(1) == 0) {
+        g_sink = std::make_shared<DevNullSink>();
+    } else {
+        logging::RotateOptions opts;
+        opts.path = (kBenchDir / "bench.log").string();
+        opts.max_bytes = 64U << 20;
+        opts.max_files = 2;
+        // 压缩线程会和被测线程抢 CPU, 这里只测写入
+        opts.compress = false;
+        g_sink = std::make_shared<logging::RotatingFileSink>(opts);
+    }
+    logging::set_sink(g_sink);
+
+    if (state.range(0) > 0) {
+        logging::AsyncOptions opts;
+        opts.overflow = logging::Overflow::BLOCK;
+        opts.deferred = state.range(0) == 2;
+        logging::start_async(opts);
+    }
+}
+
+void teardown(const benchmark::State& /*state*/) {
+    logging::stop_async();
+    logging::set_sink(nullptr);
+    g_sink.reset();
+    std::error_code ec;
+    std::filesystem::remove_all(kBenchDir, ec);
+}
+
+void setup_disabled(const benchmark::State& /*state*/) {
+    logging::set_level(LogLevel::WARN);
+}
+
+void teardown_disabled(const benchmark::State& /*state*/) {
+    logging::set_level(LogLevel::TRACE);
+}
+
+void mode_args(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"mode", "sink"});
+    for (int64_t mode : {0, 1, 2}) {
+        for (int64_t sink : {0, 1}) {
+            b->Args({mode, sink});
+        }
+    }
+}
+
+auto percentile(std::vector<int64_t>& samples, double p) -> double {
+    if (samples.empty()) {
+        return 0;
+    }
+    const auto idx = static_cast<size_t>(p * static_cast<double>(samples.size() - 1));
+    std::nth_element(
+        samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(idx), samples.end());
+    return static_cast<double>(samples[idx]);
+}
+
+// BM_LogLatency 各线程的样本在这里合并, 分位数按全体样本算
+struct LatencySamples {
+    std::mutex mutex;
+    std::vector<int64_t> all;
+    int threads = 0; // 已合并的线程数
+};
+
+} // namespace
+
+// 等级被过滤时只剩一次 relaxed load, 参数不会求值
+static void BM_LogDisabled(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        INFO("disabled id={} score={}", i++, 3.14);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LogInfo(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        INFO("request id={} latency={}us", i++, 12.5);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename T>
+auto sample_arg() -> T {
+    if constexpr (std::is_same_v<T, std::string>) {
+        return std::string(64, 'x'); // 超过 SSO
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        return "short";
+    } else {
+        return static_cast<T>(42.5);
+    }
+}
+
+template <typename T>
+static void BM_LogArgType(benchmark::State& state) {
+    const T value = sample_arg<T>();
+    for (auto _ : state) {
+        INFO("value={} value={} value={}", value, value, value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// 每次调用单独计时, 统计延迟分布. steady_clock::now() 本身约 20ns, 会计入结果
+static void BM_LogLatency(benchmark::State& state) {
+    std::vector<int64_t> samples;
+    samples.reserve(1U << 20);
+    int64_t i = 0;
+    for (auto _ : state) {
+        const auto begin = std::chrono::steady_clock::now();
+        INFO("request id={} latency={}us", i++, 12.5);
+        const auto end = std::chrono::steady_clock::now();
+        if (samples.size() < samples.capacity()) {
+            samples.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        }
+    }
+    // 最后一个合并的线程上报; 计数器跨线程求和, 其它线程不设就等于这一份
+    static LatencySamples merged;
+    const std::scoped_lock lock(merged.mutex);
+    merged.all.insert(merged.all.end(), samples.begin(), samples.end());
+    if (++merged.threads < state.threads()) {
+        return;
+    }
+    for (const auto& [name, p] : {
+             std::pair{"p50_ns", 0.50},
+             std::pair{"p99_ns", 0.99},
+             std::pair{"p999_ns", 0.999},
+             std::pair{"max_ns", 1.0},
+         }) {
+        state.counters[name] = percentile(merged.all, p);
+    }
+    merged.all.clear();
+    merged.threads = 0;
+}
+
+BENCHMARK(BM_LogDisabled)->Setup(setup_disabled)->Teardown(teardown_disabled)->ThreadRange(1, 8);
+BENCHMARK(BM_LogInfo)
+    ->Apply(mode_args)
+    ->Setup(setup)
+    ->Teardown(teardown)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_LogArgType, int64_t)->Apply(mode_args)->Setup(setup)->Teardown(teardown);
+BENCHMARK_TEMPLATE(BM_LogArgType, double)->Apply(mode_args)->Setup(setup)->Teardown(teardown);
+BENCHMARK_TEMPLATE(BM_LogArgType, std::string_view)
+    ->Apply(mode_args)
+    ->Setup(setup)
+    ->Teardown(teardown);
+BENCHMARK_TEMPLATE(BM_LogArgType, std::string)->Apply(mode_args)->Setup(setup)->Teardown(teardown);
+BENCHMARK(BM_LogLatency)
+    ->Apply(mode_args)
+    ->Setup(setup)
+    ->Teardown(teardown)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,426 @@
+#include "lib/aio.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+#endif
+
+#include "exec/static_thread_pool.hpp"
+#include "lib/log.h"
+#include "stdexec/execution.hpp"
+
+namespace {
+
+auto blocking_io(const AsyncIo::Request& req) -> int {
+    ssize_t n = 0;
+    switch (req.op) {
+        case AsyncIo::Op::READ:
+        case AsyncIo::Op::READ_FIXED:
+            n = pread(req.fd, req.buf, req.len, static_cast<off_t>(req.offset));
+            break;
+        case AsyncIo::Op::WRITE:
+        case AsyncIo::Op::WRITE_FIXED:
+            n = pwrite(req.fd, req.buf, req.len, static_cast<off_t>(req.offset));
+            break;
+    }
+    return n < 0 ? -errno : static_cast<int>(n);
+}
+
+// 和内核的 MAX_RW_COUNT 相同, 结果也放得进 int. 更长的 buffer 按短读写处理
+constexpr size_t kMaxLen = 0x7FFFF000;
+
+auto clamp_len(size_t size) -> uint32_t {
+    return static_cast<uint32_t>(std::min(size, kMaxLen));
+}
+
+template <typename T>
+auto load_acquire(T* ptr) -> T {
+    return std::atomic_ref<T>(*ptr).load(std::memory_order_acquire);
+}
+
+template <typename T>
+void store_release(T* ptr, T value) {
+    std::atomic_ref<T>(*ptr).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+#ifdef __linux__
+
+// 直接走系统调用, 不依赖 liburing.
+struct AsyncIo::Ring {
+    int fd = -1;
+    io_uring_params params{};
+
+    void* sq_ptr = nullptr;
+    size_t sq_size = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    // 已写入 SQ 但尚未 io_uring_enter 的数量
+    unsigned pending = 0;
+
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring(Ring&&) = delete;
+    auto operator=(const Ring&) -> Ring& = delete;
+    auto operator=(Ring&&) -> Ring& = delete;
+
+    ~Ring() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+            munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr != nullptr) {
+            munmap(sq_ptr, sq_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    auto setup(unsigned entries) -> bool {
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+
+        sq_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+        cq_size = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+
+        sq_ptr = mmap(
+            nullptr,
+            sq_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            sq_ptr = nullptr;
+            return false;
+        }
+
+        if (single_mmap) {
+            cq_ptr = sq_ptr;
+        } else {
+            cq_ptr = mmap(
+                nullptr,
+                cq_size,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                fd,
+                IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED) {
+                cq_ptr = nullptr;
+                return false;
+            }
+        }
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void* ptr = mmap(
+            nullptr,
+            sqes_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQES);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(ptr);
+
+        auto* sq = static_cast<char*>(sq_ptr);
+        auto* cq = static_cast<char*>(cq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head); // NOLINT
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail); // NOLINT
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask); // NOLINT
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array); // NOLINT
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head); // NOLINT
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail); // NOLINT
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask); // NOLINT
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes); // NOLINT
+        return true;
+    }
+
+    // IORING_OP_READ / WRITE 和 IORING_REGISTER_PROBE 同在 5.6 加入. 5.1-5.5 上 setup 能成功,
+    // 但读写请求全部返回 -EINVAL, 所以探测失败也当作不支持
+    [[nodiscard]] auto supports_read_write() const -> bool {
+        constexpr unsigned kOps = 256;
+        std::vector<std::byte> buffer(sizeof(io_uring_probe) + (kOps * sizeof(io_uring_probe_op)));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data()); // NOLINT
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+            return false;
+        }
+        auto supported = [probe](unsigned op) -> bool {
+            return op <= probe->last_op
+                   && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0; // NOLINT
+        };
+        return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+    }
+
+    auto enter(unsigned to_submit, unsigned min_complete, unsigned flags) -> int {
+        int ret = 0;
+        do {
+            ret = static_cast<int>(
+                syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        } while (ret < 0 && errno == EINTR);
+        return ret < 0 ? -errno : ret;
+    }
+
+    auto submit(unsigned min_complete) -> int {
+        const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0U;
+        if (pending == 0 && min_complete == 0) {
+            return 0;
+        }
+        int ret = enter(pending, min_complete, flags);
+        if (ret > 0) {
+            pending -= std::min(pending, static_cast<unsigned>(ret));
+        }
+        return ret;
+    }
+
+    // SQ 满时先把积攒的请求提交掉
+    auto get_sqe() -> io_uring_sqe* {
+        unsigned tail = *sq_tail;
+        if (tail - load_acquire(sq_head) >= params.sq_entries) {
+            submit(0);
+            if (tail - load_acquire(sq_head) >= params.sq_entries) {
+                return nullptr;
+            }
+        }
+        io_uring_sqe* sqe = &sqes[tail & *sq_mask]; // NOLINT
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    void push(io_uring_sqe* sqe) {
+        unsigned tail = *sq_tail;
+        auto idx = static_cast<unsigned>(sqe - sqes);
+        sq_array[tail & *sq_mask] = idx; // NOLINT
+        store_release(sq_tail, tail + 1);
+        ++pending;
+    }
+};
+
+#else
+
+struct AsyncIo::Ring {};
+
+#endif
+
+struct AsyncIo::Fallback {
+    exec::static_thread_pool pool;
+
+    explicit Fallback(unsigned threads) : pool(threads) {}
+};
+
+AsyncIo::AsyncIo(unsigned entries, unsigned fallback_threads) {
+#ifdef __linux__
+    auto ring = std::make_unique<Ring>();
+    if (ring->setup(entries) && ring->supports_read_write()) {
+        ring_ = std::move(ring);
+        return;
+    }
+#endif
+    fallback_ = std::make_unique<Fallback>(fallback_threads);
+}
+
+AsyncIo::~AsyncIo() {
+    // 析构函数不能抛异常: io_uring_enter 出错时记日志并放弃等待, 未完成的请求随 ring 一起关闭
+    try {
+        drain();
+    } catch (const std::system_error& e) {
+        ERROR("AsyncIo: drain on destruction failed, {} requests abandoned: {}",
+              inflight_, e.what());
+    }
+}
+
+auto AsyncIo::read_at(int fd, std::span<std::byte> buf, off_t offset) -> Awaiter {
+    Awaiter awaiter{this, {}};
+    awaiter.req.op = Op::READ;
+    awaiter.req.fd = fd;
+    awaiter.req.buf = buf.data();
+    awaiter.req.len = clamp_len(buf.size());
+    awaiter.req.offset = static_cast<uint64_t>(offset);
+    return awaiter;
+}
+
+auto AsyncIo::write_at(int fd, std::span<const std::byte> buf, off_t offset) -> Awaiter {
+    Awaiter awaiter{this, {}};
+    awaiter.req.op = Op::WRITE;
+    awaiter.req.fd = fd;
+    awaiter.req.buf = const_cast<std::byte*>(buf.data()); // NOLINT
+    awaiter.req.len = clamp_len(buf.size());
+    awaiter.req.offset = static_cast<uint64_t>(offset);
+    return awaiter;
+}
+
+auto AsyncIo::read_fixed(int fd, uint16_t buf_index, std::span<std::byte> buf, off_t offset)
+    -> Awaiter {
+    auto awaiter = read_at(fd, buf, offset);
+    awaiter.req.op = Op::READ_FIXED;
+    awaiter.req.buf_index = buf_index;
+    return awaiter;
+}
+
+auto AsyncIo::write_fixed(
+    int fd, uint16_t buf_index, std::span<const std::byte> buf, off_t offset) -> Awaiter {
+    auto awaiter = write_at(fd, buf, offset);
+    awaiter.req.op = Op::WRITE_FIXED;
+    awaiter.req.buf_index = buf_index;
+    return awaiter;
+}
+
+auto AsyncIo::register_buffers(std::span<const iovec> buffers) -> int {
+#ifdef __linux__
+    if (ring_) {
+        auto ret = syscall(
+            __NR_io_uring_register,
+            ring_->fd,
+            IORING_REGISTER_BUFFERS,
+            buffers.data(),
+            static_cast<unsigned>(buffers.size()));
+        return ret < 0 ? -errno : 0;
+    }
+#endif
+    // 线程池模式下 fixed 请求按普通读写处理
+    return 0;
+}
+
+void AsyncIo::enqueue(Request* req) {
+    ++inflight_;
+
+#ifdef __linux__
+    if (ring_) {
+        io_uring_sqe* sqe = ring_->get_sqe();
+        if (sqe == nullptr) {
+            // 内核迟迟不消费 SQ, 同步完成这一个请求
+            req->result = blocking_io(*req);
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(req);
+            return;
+        }
+
+        switch (req->op) {
+            case Op::READ:
+                sqe->opcode = IORING_OP_READ;
+                break;
+            case Op::WRITE:
+                sqe->opcode = IORING_OP_WRITE;
+                break;
+            case Op::READ_FIXED:
+                sqe->opcode = IORING_OP_READ_FIXED;
+                sqe->buf_index = req->buf_index;
+                break;
+            case Op::WRITE_FIXED:
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->buf_index = req->buf_index;
+                break;
+        }
+        sqe->fd = req->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(req->buf); // NOLINT
+        sqe->len = req->len;
+        sqe->off = req->offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(req); // NOLINT
+        ring_->push(sqe);
+        return;
+    }
+#endif
+
+    stdexec::start_detached(
+        stdexec::schedule(fallback_->pool.get_scheduler())
+        | stdexec::then([this, req]() -> void {
+              req->result = blocking_io(*req);
+              // 持锁通知, 避免 drain 返回后 AsyncIo 被析构时这里仍在访问 cv_
+              std::lock_guard<std::mutex> lock(mutex_);
+              done_.push_back(req);
+              cv_.notify_one();
+          }));
+}
+
+auto AsyncIo::submit() -> int {
+#ifdef __linux__
+    if (ring_) {
+        return ring_->submit(0);
+    }
+#endif
+    return 0;
+}
+
+void AsyncIo::reap(bool wait) {
+    std::vector<Request*> ready;
+
+#ifdef __linux__
+    if (ring_) {
+        bool has_done = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            has_done = !done_.empty();
+        }
+
+        int ret = ring_->submit(wait && !has_done ? 1 : 0);
+        if (ret < 0 && ret != -EBUSY && ret != -EAGAIN && ret != -EINTR) {
+            throw std::system_error(-ret, std::system_category(), "io_uring_enter");
+        }
+
+        unsigned head = *ring_->cq_head;
+        const unsigned tail = load_acquire(ring_->cq_tail);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = ring_->cqes[head & *ring_->cq_mask]; // NOLINT
+            auto* req = reinterpret_cast<Request*>(cqe.user_data); // NOLINT
+            req->result = cqe.res;
+            ready.push_back(req);
+        }
+        store_release(ring_->cq_head, head);
+    }
+#endif
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wait && ready.empty() && !ring_) {
+            cv_.wait(lock, [this] -> bool { return !done_.empty(); });
+        }
+        ready.insert(ready.end(), done_.begin(), done_.end());
+        done_.clear();
+    }
+
+    inflight_ -= ready.size();
+    for (auto* req : ready) {
+        req->handle.resume();
+    }
+}
+
+void AsyncIo::drain() {
+    while (inflight_ > 0) {
+        reap(true);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// 基于 io_uring 的文件读写, 供 Task<T> 直接 co_await.
+//
+//   auto load(AsyncIo& io, int fd, std::span<std::byte> buf) -> Task<int> {
+//       co_return co_await io.read_at(fd, buf, 0);
+//   }
+//
+//   AsyncIo io;
+//   auto task = load(io, fd, buf);
+//   task.resume();   // 运行到第一个 co_await, 请求进入提交队列
+//   io.drain();      // 批量提交并在当前线程恢复协程, 直到没有未完成的请求
+//
+// 结果与系统调用一致: >= 0 为读写字节数, < 0 为 -errno. 和 read(2) 一样单次最多读写
+// 0x7FFFF000 字节, 更长的 buffer 得到短读写.
+// io_uring 不可用 (老内核, seccomp, 非 linux) 时退化为线程池上的 pread/pwrite,
+// 协程仍在调用 drain() 的线程上恢复.
+class AsyncIo {
+public:
+    enum class Op : uint8_t {
+        READ,
+        WRITE,
+        READ_FIXED,
+        WRITE_FIXED,
+    };
+
+    struct Request {
+        Op op = Op::READ;
+        int fd = -1;
+        void* buf = nullptr;
+        uint32_t len = 0;
+        uint64_t offset = 0;
+        uint16_t buf_index = 0;
+        int result = 0;
+        std::coroutine_handle<> handle;
+    };
+
+    struct Awaiter {
+        AsyncIo* io;
+        Request req;
+
+        static auto await_ready() noexcept -> bool { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            req.handle = handle;
+            io->enqueue(&req);
+        }
+
+        [[nodiscard]] auto await_resume() const noexcept -> int { return req.result; }
+    };
+
+    explicit AsyncIo(unsigned entries = 256, unsigned fallback_threads = 4);
+
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo(AsyncIo&&) = delete;
+    auto operator=(const AsyncIo&) -> AsyncIo& = delete;
+    auto operator=(AsyncIo&&) -> AsyncIo& = delete;
+
+    ~AsyncIo();
+
+    auto read_at(int fd, std::span<std::byte> buf, off_t offset) -> Awaiter;
+
+    auto write_at(int fd, std::span<const std::byte> buf, off_t offset) -> Awaiter;
+
+    // 注册后的 buffer 由内核预先 pin 住, 省去每次请求的页表映射; 返回 0 或 -errno.
+    // buf 必须落在 register_buffers 传入的第 buf_index 个 iovec 内.
+    auto register_buffers(std::span<const iovec> buffers) -> int;
+
+    auto read_fixed(int fd, uint16_t buf_index, std::span<std::byte> buf, off_t offset)
+        -> Awaiter;
+
+    auto write_fixed(int fd, uint16_t buf_index, std::span<const std::byte> buf, off_t offset)
+        -> Awaiter;
+
+    // 把已排队的请求一次性提交给内核, 返回提交数量.
+    auto submit() -> int;
+
+    // 提交并等待所有请求完成, 期间在当前线程恢复对应的协程.
+    void drain();
+
+    [[nodiscard]] auto uring() const -> bool { return ring_ != nullptr; }
+
+    [[nodiscard]] auto inflight() const -> size_t { return inflight_; }
+
+private:
+    struct Ring;
+    struct Fallback;
+
+    void enqueue(Request* req);
+    void reap(bool wait);
+
+    std::unique_ptr<Ring> ring_;
+    std::unique_ptr<Fallback> fallback_;
+    std::vector<Request*> done_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t inflight_ = 0;
+};
@@ -1,23 +1,130 @@
 #include "lib/cmd.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
 auto exec_cmd(const std::vector<std::string>& args) -> std::string {
+    CmdOptions opts;
+    opts.max_capture = SIZE_MAX;
+    auto result = run_cmd(args, opts);
+
+    if (result.error) {
+        return result.error.message();
+    }
+    return result.out;
+}
+
+auto run_cmd(const std::vector<std::string>& args, const CmdOptions& opts) -> CmdResult {
+    CmdResult result;
+
+    reproc::options options;
+    if (opts.timeout.count() > 0) {
+        options.deadline = reproc::milliseconds(opts.timeout.count());
+    }
+
     reproc::process process;
+    if (auto ec = process.start(args, options); ec) {
+        result.error = ec;
+        return result;
+    }
+
+    using Callback = std::function<void(std::string_view)>;
+    auto sink = [&opts](const Callback& callback, std::string& capture) {
+        return [&opts, &callback, &capture](
+                   reproc::stream /*stream*/,
+                   const uint8_t* buffer,
+                   size_t size) -> std::error_code {
+            const std::string_view chunk(reinterpret_cast<const char*>(buffer), size); // NOLINT
+            if (chunk.empty()) {
+                return {};
+            }
+            if (callback) {
+                callback(chunk);
+            } else if (capture.size() < opts.max_capture) {
+                capture.append(chunk.substr(0, opts.max_capture - capture.size()));
+            }
+            return {};
+        };
+    };
 
-    if (const auto& ec = process.start(args); ec) {
-        return ec.message();
+    // 有 deadline 时 drain 在到期后返回 timed_out, 不会一直等一个不退出的子进程
+    auto ec = reproc::drain(
+        process, sink(opts.on_stdout, result.out), sink(opts.on_stderr, result.err));
+    if (ec == std::errc::timed_out) {
+        result.timed_out = true;
+    } else if (ec) {
+        result.error = ec;
     }
 
-    std::string output;
+    // 先等到 deadline, 之后依次 SIGTERM / SIGKILL
+    reproc::stop_actions stop = {
+        {reproc::stop::wait, result.timed_out ? reproc::milliseconds(0) : reproc::deadline},
+        {reproc::stop::terminate, reproc::milliseconds(opts.grace.count())},
+        {reproc::stop::kill, reproc::milliseconds(opts.grace.count())},
+    };
+    auto [status, stop_ec] = process.stop(stop);
+    if (stop_ec == std::errc::timed_out) {
+        result.timed_out = true;
+    } else if (stop_ec && !result.error) {
+        result.error = stop_ec;
+    }
+    // reproc 对被信号结束的进程返回 UINT8_MAX + 信号值 (REPROC_SIGKILL 为 255 + 9)
+    if (status > UINT8_MAX) {
+        result.signal = status - UINT8_MAX;
+        result.status = 128 + result.signal;
+    } else {
+        result.status = status;
+    }
+    return result;
+}
+
+CmdPool::CmdPool(size_t max_procs) {
+    max_procs = std::max<size_t>(max_procs, 1);
+    workers_.reserve(max_procs);
+    for (size_t i = 0; i < max_procs; ++i) {
+        workers_.emplace_back([this] -> void { run(); });
+    }
+}
 
-    if (const auto& ec = reproc::drain(process, reproc::sink::string(output), reproc::sink::null);
-        ec) {
-        return ec.message();
+CmdPool::~CmdPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
     }
+}
 
-    auto [status, error] = process.wait(reproc::infinite);
+auto CmdPool::submit(std::vector<std::string> args, CmdOptions opts) -> std::future<CmdResult> {
+    auto fn = [args = std::move(args), opts = std::move(opts)] -> CmdResult {
+        return run_cmd(args, opts);
+    };
+    std::packaged_task<CmdResult()> task(std::move(fn));
+    auto future = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(task));
+    }
+    cv_.notify_one();
+    return future;
+}
 
-    if (error) {
-        return error.message();
+void CmdPool::run() {
+    while (true) {
+        std::packaged_task<CmdResult()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] -> bool { return stop_ || !tasks_.empty(); });
+            // 析构时先把队列里的命令跑完再退出
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
     }
-    return output;
 }
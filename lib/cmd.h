@@ -1,9 +1,67 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 #include <reproc++/drain.hpp>
 #include <reproc++/reproc.hpp>
 
-auto exec_cmd(const std::vector<std::string>& args) -> std::string;
\ No newline at end of file
+auto exec_cmd(const std::vector<std::string>& args) -> std::string;
+
+struct CmdOptions {
+    // 0 表示不限时. 超时后先 SIGTERM, 等 grace 后仍未退出再 SIGKILL
+    std::chrono::milliseconds timeout{0};
+    std::chrono::milliseconds grace{1000};
+    // 输出按块回调, 在执行命令的线程上调用. 未设置时输出收集到 CmdResult 中
+    std::function<void(std::string_view)> on_stdout;
+    std::function<void(std::string_view)> on_stderr;
+    // 收集到 CmdResult 的每路输出的上限, 超出部分丢弃
+    size_t max_capture = 1U << 20;
+};
+
+struct CmdResult {
+    int status = -1; // 退出码, 被信号结束时和 shell 一样为 128 + 信号值
+    int signal = 0; // 结束子进程的信号, 正常退出时为 0
+    bool timed_out = false;
+    std::error_code error;
+    std::string out;
+    std::string err;
+};
+
+// 在当前线程执行命令, 边读边回调, 不会无限期阻塞 (设置了 timeout 时)
+auto run_cmd(const std::vector<std::string>& args, const CmdOptions& opts = {}) -> CmdResult;
+
+// 固定数量的工作线程, 同时最多运行 max_procs 个子进程, 多出的命令排队
+class CmdPool {
+public:
+    explicit CmdPool(size_t max_procs);
+
+    CmdPool(const CmdPool&) = delete;
+    CmdPool(CmdPool&&) = delete;
+    auto operator=(const CmdPool&) -> CmdPool& = delete;
+    auto operator=(CmdPool&&) -> CmdPool& = delete;
+
+    // 等待已提交的命令全部结束
+    ~CmdPool();
+
+    auto submit(std::vector<std::string> args, CmdOptions opts = {}) -> std::future<CmdResult>;
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::queue<std::packaged_task<CmdResult()>> tasks_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
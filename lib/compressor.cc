@@ -128,11 +128,21 @@ struct ZstdImpl final : Compressor {
             return "";
         }
 
-        // 从压缩帧中获取原始大小
-        uint64_t original_size = ZSTD_getFrameContentSize(data.c_str(), data.size());
-
-        if (original_size == ZSTD_CONTENTSIZE_ERROR || original_size == ZSTD_CONTENTSIZE_UNKNOWN) {
-            throw std::runtime_error("Zstd: failed to get decompressed size from header.");
+        // 从压缩帧中获取原始大小. 输入可能是首尾相连的多个帧 (分块压缩的结果), 逐帧累加
+        uint64_t original_size = 0;
+        for (size_t offset = 0; offset < data.size();) {
+            const char* frame = data.c_str() + offset;
+            const size_t remaining = data.size() - offset;
+            const uint64_t frame_size = ZSTD_getFrameContentSize(frame, remaining);
+            if (frame_size == ZSTD_CONTENTSIZE_ERROR || frame_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+                throw std::runtime_error("Zstd: failed to get decompressed size from header.");
+            }
+            const size_t frame_bytes = ZSTD_findFrameCompressedSize(frame, remaining);
+            if (ZSTD_isError(frame_bytes)) { // NOLINT
+                throw std::runtime_error("Zstd: truncated frame.");
+            }
+            original_size += frame_size;
+            offset += frame_bytes;
         }
         if (original_size == 0) {
             return ""; // 原始数据是空的
@@ -2,24 +2,71 @@
 
 #include <coroutine>
 #include <exception>
+#include <utility>
 #include <variant>
 
+#include "stdexec/execution.hpp"
+
+// Task<T> 是惰性协程: 创建时挂起, 由 resume() / co_await / stdexec::connect 启动.
+//
+// - promise 继承 stdexec::with_awaitable_senders, 协程体内可以直接 co_await 任意 sender,
+//   例如 co_await stdexec::schedule(pool.get_scheduler()) 切到线程池.
+// - Task 本身是 awaitable, stdexec 会把 awaitable 当作 sender, 因此可以直接交给
+//   stdexec::sync_wait / when_all / starts_on.
+// - 完成时通过对称转移 (symmetric transfer) 恢复等待方, 不会额外切线程.
+
+namespace coro_detail {
+
+template <typename Promise>
+struct FinalAwaiter {
+    static auto await_ready() noexcept -> bool { return false; }
+
+    static auto await_suspend(std::coroutine_handle<Promise> self) noexcept
+        -> std::coroutine_handle<> {
+        if (auto cont = self.promise().continuation().handle()) {
+            return cont;
+        }
+        return std::noop_coroutine();
+    }
+
+    static void await_resume() noexcept {}
+};
+
+template <typename Promise>
+struct PromiseBase : stdexec::with_awaitable_senders<Promise> {
+    static auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+
+    static auto final_suspend() noexcept -> FinalAwaiter<Promise> { return {}; }
+};
+
+template <typename Promise>
+struct TaskAwaiter {
+    std::coroutine_handle<Promise> handle;
+
+    static auto await_ready() noexcept -> bool { return false; }
+
+    template <typename OtherPromise>
+    auto await_suspend(std::coroutine_handle<OtherPromise> caller) noexcept
+        -> std::coroutine_handle<> {
+        handle.promise().set_continuation(caller);
+        return handle;
+    }
+
+    auto await_resume() -> decltype(auto) { return handle.promise().get_result(); }
+};
+
+} // namespace coro_detail
+
 template <typename T>
 class Task {
 public:
-    struct promise_type {
+    struct promise_type : coro_detail::PromiseBase<promise_type> {
         std::variant<std::monostate, T, std::exception_ptr> result;
 
         auto get_return_object() -> Task {
             return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
         }
 
-        auto initial_suspend() noexcept -> std::suspend_never { return {}; }
-
-        auto final_suspend() noexcept -> std::suspend_never { return {}; }
-
-        void return_void() {}
-
         void unhandled_exception() { result = std::current_exception(); }
 
         template <typename U>
@@ -47,6 +94,10 @@ public:
 
     auto get_handle() -> std::coroutine_handle<promise_type> { return handle_; }
 
+    auto operator co_await() && noexcept -> coro_detail::TaskAwaiter<promise_type> {
+        return {handle_};
+    }
+
     Task(const Task&) = delete;
     auto operator=(const Task&) -> Task& = delete;
 
@@ -78,17 +129,13 @@ private:
 template <>
 class Task<void> {
 public:
-    struct promise_type {
+    struct promise_type : coro_detail::PromiseBase<promise_type> {
         std::exception_ptr exception;
 
         auto get_return_object() -> Task {
             return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
         }
 
-        static auto initial_suspend() -> std::suspend_never { return {}; }
-
-        static auto final_suspend() noexcept -> std::suspend_never { return {}; }
-
         void return_void() {}
 
         void unhandled_exception() { exception = std::current_exception(); }
@@ -112,6 +159,10 @@ public:
 
     auto get_handle() -> std::coroutine_handle<promise_type> { return handle_; }
 
+    auto operator co_await() && noexcept -> coro_detail::TaskAwaiter<promise_type> {
+        return {handle_};
+    }
+
     Task(const Task&) = delete;
     auto operator=(const Task&) -> Task& = delete;
 
@@ -138,4 +189,4 @@ public:
 
 private:
     std::coroutine_handle<promise_type> handle_;
-};
\ No newline at end of file
+};
@@ -0,0 +1,122 @@
+#include "lib/json.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace json {
+
+namespace {
+
+struct PathHash {
+    using is_transparent = void;
+
+    auto operator()(std::string_view path) const -> size_t {
+        return std::hash<std::string_view>{}(path);
+    }
+};
+
+// 按 path 的哈希分片, 读多写少, 每片一把读写锁
+class PointerCache {
+public:
+    static auto instance() -> PointerCache& {
+        static PointerCache cache;
+        return cache;
+    }
+
+    auto get(std::string_view path) -> const rapidjson::Pointer& {
+        const size_t hash = PathHash{}(path);
+        Shard& shard = shards_[hash % kShards];
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            if (auto it = shard.map.find(path); it != shard.map.end()) {
+                return *it->second;
+            }
+        }
+
+        // 锁外解析, 并发首次访问时多解析一次也无妨, 以先插入的为准
+        auto compiled = std::make_unique<rapidjson::Pointer>(path.data(), path.size());
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.map.try_emplace(std::string(path), std::move(compiled));
+        return *it->second;
+    }
+
+private:
+    static constexpr size_t kShards = 16;
+
+    struct Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string,
+                           std::unique_ptr<rapidjson::Pointer>,
+                           PathHash,
+                           std::equal_to<>>
+            map;
+    };
+
+    std::array<Shard, kShards> shards_;
+};
+
+} // namespace
+
+Context::Context()
+    : arena_(std::make_unique_for_overwrite<char[]>(kInitialArena)), // NOLINT
+      pool_(std::in_place, arena_.get(), kInitialArena),
+      doc_(&*pool_),
+      buffer_writer_(buffer_),
+      writer_(output_) {}
+
+auto pointer(std::string_view path) -> const rapidjson::Pointer* {
+    const rapidjson::Pointer& p = PointerCache::instance().get(path);
+    return p.IsValid() ? &p : nullptr;
+}
+
+auto Context::local() -> Context& {
+    thread_local Context ctx;
+    return ctx;
+}
+
+void Context::reset() {
+    doc_.SetNull();
+    if (pool_->Size() > arena_size_ / 2 && arena_size_ < kMaxArena) {
+        // 上次的文档溢出了 arena (或接近溢出), 换一块更大的 (不超过 kMaxArena),
+        // 之后同样大小的文档都落在 arena 里, 不再向系统要内存
+        arena_size_ = std::min(std::bit_ceil(pool_->Size() * 2), kMaxArena);
+        pool_.reset();
+        arena_ = std::make_unique_for_overwrite<char[]>(arena_size_); // NOLINT
+        pool_.emplace(arena_.get(), arena_size_);
+    } else {
+        pool_->Clear();
+    }
+}
+
+auto Context::document() -> rapidjson::Document& {
+    reset();
+    doc_.SetObject();
+    return doc_;
+}
+
+auto Context::parse_insitu(std::string& buffer) -> rapidjson::Document& {
+    reset();
+    doc_.ParseInsitu(buffer.data());
+    return doc_;
+}
+
+auto Context::buffer_writer() -> rapidjson::Writer<rapidjson::StringBuffer>& {
+    buffer_.Clear();
+    buffer_writer_.Reset(buffer_);
+    return buffer_writer_;
+}
+
+auto Context::writer(std::string& dst) -> rapidjson::Writer<StringOutput>& {
+    output_.out = &dst;
+    writer_.Reset(output_);
+    return writer_;
+}
+
+} // namespace json
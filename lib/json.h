@@ -0,0 +1,955 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "rapidjson/allocators.h"
+#include "rapidjson/document.h"
+#include "rapidjson/pointer.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/stream.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+// 结构体字段描述 + SAX 序列化.
+//
+//   struct Item {
+//       int64_t id = 0;
+//       std::vector<std::string> tags;
+//       JSON_FIELDS(Item, id, tags)
+//   };
+//   std::string s = json::to_json(item);
+//
+// JSON_FIELDS 在编译期生成 (名字, 成员指针) 的 tuple, 序列化时逐个字段直接调用
+// rapidjson::Writer, 不构造 Document. 字段可以是数值 / bool / 字符串 / optional / 枚举,
+// 也可以是 vector 之类的 range, key 为字符串或整数的 map, 以及另一个带 JSON_FIELDS 的结构体.
+//
+// 反序列化 from_json 用同一份字段描述: Reader 逐个 token 拉取, key 经编译期生成的完美哈希
+// 直接定位到成员, 不建 DOM, 不解析 Pointer. 未知的 key 整体跳过, 类型不匹配的值忽略,
+// 成员保持原值. from_json_insitu 在可写的输入上原地解析, 这时成员可以是指向输入的
+// std::string_view. from_json 跳过空白时按运行时检测到的指令集走 SIMD, 元素全是整数或
+// 字符串的数组直接扫描输入, 不逐个 token 回调. 浮点数组只在 kParseFullPrecisionFlag 下
+// 这样做, 默认的 Reader 不保证正确舍入, 两边的结果会差最后一位.
+
+namespace json {
+
+template <typename T, typename M>
+struct Field {
+    using Owner = T;
+    using Member = M;
+
+    std::string_view name;
+    M T::* member;
+};
+
+// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define JSON_PARENS ()
+#define JSON_EXPAND(...)  JSON_EXPAND3(JSON_EXPAND3(JSON_EXPAND3(JSON_EXPAND3(__VA_ARGS__))))
+#define JSON_EXPAND3(...) JSON_EXPAND2(JSON_EXPAND2(JSON_EXPAND2(JSON_EXPAND2(__VA_ARGS__))))
+#define JSON_EXPAND2(...) JSON_EXPAND1(JSON_EXPAND1(JSON_EXPAND1(JSON_EXPAND1(__VA_ARGS__))))
+#define JSON_EXPAND1(...) __VA_ARGS__
+
+#define JSON_FOR_EACH(macro, type, ...) \
+    __VA_OPT__(JSON_EXPAND(JSON_FOR_EACH_HELPER(macro, type, __VA_ARGS__)))
+#define JSON_FOR_EACH_HELPER(macro, type, first, ...) \
+    macro(type, first) __VA_OPT__(, JSON_FOR_EACH_AGAIN JSON_PARENS(macro, type, __VA_ARGS__))
+#define JSON_FOR_EACH_AGAIN() JSON_FOR_EACH_HELPER
+
+#define JSON_FIELD(Type, member) \
+    ::json::Field<Type, decltype(Type::member)> { #member, &Type::member }
+
+// 写在结构体内部, 字段顺序即输出顺序
+#define JSON_FIELDS(Type, ...)                                         \
+    static constexpr auto json_fields() {                              \
+        return std::tuple{JSON_FOR_EACH(JSON_FIELD, Type, __VA_ARGS__)}; \
+    }
+// NOLINTEND(cppcoreguidelines-macro-usage)
+
+template <typename T>
+concept Reflected = requires { T::json_fields(); };
+
+template <typename T>
+concept StringLike = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+concept MapLike = std::ranges::input_range<T> && requires {
+    typename T::key_type;
+    typename T::mapped_type;
+};
+
+template <typename T>
+struct IsOptional : std::false_type {};
+
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool always_false_v = false;
+
+template <typename Writer, typename T>
+void write(Writer& w, const T& value);
+
+namespace detail {
+
+template <typename Writer>
+void write_key(Writer& w, std::string_view key) {
+    w.Key(key.data(), static_cast<rapidjson::SizeType>(key.size()));
+}
+
+// JSON 的 key 只能是字符串, 整数 key 按十进制写出
+template <typename Writer, typename K>
+void write_map_key(Writer& w, const K& key) {
+    if constexpr (StringLike<K>) {
+        write_key(w, key);
+    } else if constexpr (std::is_integral_v<K>) {
+        char buf[24]; // NOLINT
+        auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), key);
+        write_key(w, std::string_view(buf, end));
+    } else {
+        static_assert(always_false_v<K>, "JSON object keys must be strings or integers");
+    }
+}
+
+template <typename Writer, typename T>
+void write_object(Writer& w, const T& value) {
+    w.StartObject();
+    std::apply(
+        [&](const auto&... fields) -> void {
+            ((write_key(w, fields.name), json::write(w, value.*(fields.member))), ...);
+        },
+        T::json_fields());
+    w.EndObject();
+}
+
+} // namespace detail
+
+// 按类型在编译期选择 Writer 调用, 不支持的类型编译失败
+template <typename Writer, typename T>
+void write(Writer& w, const T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+        w.Bool(value);
+    } else if constexpr (std::is_enum_v<T>) {
+        json::write(w, std::to_underlying(value));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        if constexpr (sizeof(T) <= sizeof(int)) {
+            w.Int(value);
+        } else {
+            w.Int64(value);
+        }
+    } else if constexpr (std::is_integral_v<T>) {
+        if constexpr (sizeof(T) <= sizeof(unsigned)) {
+            w.Uint(value);
+        } else {
+            w.Uint64(value);
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        w.Double(static_cast<double>(value));
+    } else if constexpr (StringLike<T>) {
+        const std::string_view s = value;
+        w.String(s.data(), static_cast<rapidjson::SizeType>(s.size()));
+    } else if constexpr (IsOptional<T>::value) {
+        if (value) {
+            json::write(w, *value);
+        } else {
+            w.Null();
+        }
+    } else if constexpr (Reflected<T>) {
+        detail::write_object(w, value);
+    } else if constexpr (MapLike<T>) {
+        w.StartObject();
+        for (const auto& [k, v] : value) {
+            detail::write_map_key(w, k);
+            json::write(w, v);
+        }
+        w.EndObject();
+    } else if constexpr (std::ranges::input_range<T>) {
+        w.StartArray();
+        for (const auto& v : value) {
+            json::write(w, v);
+        }
+        w.EndArray();
+    } else {
+        static_assert(always_false_v<T>, "Unsupported type for JSON serialization");
+    }
+}
+
+// 直接追加到 std::string 的输出流, 省掉 StringBuffer 和最后一次拷贝
+struct StringOutput {
+    using Ch = char;
+
+    std::string* out = nullptr;
+
+    void Put(char c) { out->push_back(c); } // NOLINT
+
+    void Flush() {} // NOLINT
+};
+
+// 线程内复用的序列化上下文. Writer 的层级栈, StringBuffer 和 Document 的内存池只在第一次
+// 使用 (或需要变大) 时分配, 之后每次只重置不释放. 同一线程内同一时刻只能有一个使用者,
+// 拿到的引用在下一次调用同一个接口前有效.
+class Context {
+public:
+    static constexpr size_t kInitialArena = 64U << 10;
+    // arena 最多长到这么大. 偶尔一个特别大的文档溢出的部分由 Clear 还给系统,
+    // 不会让每个线程一直占着一大块内存
+    static constexpr size_t kMaxArena = 4U << 20;
+
+    Context(const Context&) = delete;
+    Context(Context&&) = delete;
+    auto operator=(const Context&) -> Context& = delete;
+    auto operator=(Context&&) -> Context& = delete;
+
+    ~Context() = default;
+
+    static auto local() -> Context&;
+
+    // 空对象 Document, 上次的内容连同内存池一起重置
+    auto document() -> rapidjson::Document&;
+
+    // 重置后在 buffer 上原地解析, 调用方检查 HasParseError(). 字符串值指向 buffer,
+    // 节点分配在同一个内存池里. 返回的就是 document() 那一个, 互相覆盖
+    auto parse_insitu(std::string& buffer) -> rapidjson::Document&;
+
+    // 清空 buffer() 并返回写入它的 Writer
+    auto buffer_writer() -> rapidjson::Writer<rapidjson::StringBuffer>&;
+    [[nodiscard]] auto buffer() const -> const rapidjson::StringBuffer& { return buffer_; }
+
+    // 追加到 dst 末尾的 Writer, 写完不需要再拷贝
+    auto writer(std::string& dst) -> rapidjson::Writer<StringOutput>&;
+
+private:
+    Context();
+
+    void reset();
+
+    // 内存池的第一块用自己的 arena, Clear 只释放 arena 之外的块
+    std::unique_ptr<char[]> arena_; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    size_t arena_size_ = kInitialArena;
+    std::optional<rapidjson::MemoryPoolAllocator<>> pool_;
+    rapidjson::Document doc_;
+
+    rapidjson::StringBuffer buffer_;
+    rapidjson::Writer<rapidjson::StringBuffer> buffer_writer_;
+
+    StringOutput output_;
+    rapidjson::Writer<StringOutput> writer_;
+};
+
+// 进程内共享的 Pointer 缓存: 同一个 path 只解析一次, 之后按 path 的哈希在分片表里取出
+// 编译好的 token. 条目不淘汰, 适合反复使用的有限一组 path. 非法的 path 返回 nullptr
+[[nodiscard]] auto pointer(std::string_view path) -> const rapidjson::Pointer*;
+
+template <typename T>
+void to_json(const T& value, std::string& dst) {
+    json::write(Context::local().writer(dst), value);
+}
+
+template <typename T>
+[[nodiscard]] auto to_json(const T& value) -> std::string {
+    std::string dst;
+    to_json(value, dst);
+    return dst;
+}
+
+// Reader 的 handler, 只保存最近一个 token. 字符串指向 Reader 内部的栈,
+// 读取下一个 token 之前有效
+enum class Token : uint8_t {
+    NONE,
+    NUL,
+    BOOL,
+    INT,
+    UINT,
+    DOUBLE,
+    STRING,
+    KEY,
+    START_OBJECT,
+    END_OBJECT,
+    START_ARRAY,
+    END_ARRAY,
+};
+
+// NOLINTBEGIN(readability-convert-member-functions-to-static)
+struct Event {
+    Token token = Token::NONE;
+    bool b = false;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    std::string_view str;
+
+    auto Null() -> bool { return set(Token::NUL); }
+
+    auto Bool(bool v) -> bool {
+        b = v;
+        return set(Token::BOOL);
+    }
+
+    auto Int(int v) -> bool { return Int64(v); }
+
+    auto Int64(int64_t v) -> bool {
+        i = v;
+        return set(Token::INT);
+    }
+
+    auto Uint(unsigned v) -> bool { return Uint64(v); }
+
+    auto Uint64(uint64_t v) -> bool {
+        u = v;
+        return set(Token::UINT);
+    }
+
+    auto Double(double v) -> bool {
+        d = v;
+        return set(Token::DOUBLE);
+    }
+
+    // 只有 kParseNumbersAsStringsFlag 会用到, 不支持
+    auto RawNumber(const char* /*s*/, rapidjson::SizeType /*n*/, bool /*copy*/) -> bool {
+        return false;
+    }
+
+    auto String(const char* s, rapidjson::SizeType n, bool /*copy*/) -> bool {
+        str = {s, n};
+        return set(Token::STRING);
+    }
+
+    auto Key(const char* s, rapidjson::SizeType n, bool /*copy*/) -> bool {
+        str = {s, n};
+        return set(Token::KEY);
+    }
+
+    auto StartObject() -> bool { return set(Token::START_OBJECT); }
+
+    auto EndObject(rapidjson::SizeType /*n*/) -> bool { return set(Token::END_OBJECT); }
+
+    auto StartArray() -> bool { return set(Token::START_ARRAY); }
+
+    auto EndArray(rapidjson::SizeType /*n*/) -> bool { return set(Token::END_ARRAY); }
+
+private:
+    auto set(Token t) -> bool {
+        token = t;
+        return true;
+    }
+};
+// NOLINTEND(readability-convert-member-functions-to-static)
+
+namespace detail {
+
+// 返回 [p, end) 中第一个不是空白 (空格 \t \n \r) 的位置, 全是空白时返回 end
+[[nodiscard]] auto skip_space(const char* p, const char* end) -> const char*;
+
+// 返回 [p, end) 中第一个 " \ 或控制字符的位置, 没有时返回 end
+[[nodiscard]] auto scan_string(const char* p, const char* end) -> const char*;
+
+// p 指向开头的引号, 还原转义后追加到 out, 返回结尾引号之后的位置.
+// 非法转义, 控制字符, 不成对的代理项, 没有结尾引号时返回 nullptr
+[[nodiscard]] auto scan_quoted(const char* p, const char* end, std::string& out) -> const char*;
+
+inline std::atomic<bool> fast_paths{true};
+
+// 紧凑的 JSON 里 token 之间大多没有空白, 先看一个字节再决定要不要调用 SIMD 实现
+inline auto skip_ws(const char* p, const char* end) -> const char* {
+    if (p == end || (*p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')) {
+        return p;
+    }
+    return skip_space(p + 1, end);
+}
+
+} // namespace detail
+
+// 运行时按 CPU 选中的扫描实现: "avx2", "sse2", "neon" 或 "scalar"
+[[nodiscard]] auto simd_name() -> std::string_view;
+
+// 关掉后空白和字符串一律走标量扫描, 数组也不走快速路径. 用于对比测试, 默认打开
+inline void set_fast_paths(bool enabled) {
+    detail::fast_paths.store(enabled, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline auto fast_paths() -> bool {
+    return detail::fast_paths.load(std::memory_order_relaxed);
+}
+
+// from_json 的输入流. 和 MemoryStream 一样不要求 \0 结尾, 另外把当前位置开放给数组的
+// 快速路径. rapidjson 只给 StringStream / InsituStringStream 做了编译期的 SIMD 特化,
+// 这里由下面的 SkipWhitespace 重载 (经 ADL 找到, 优先于通用模板) 按运行时分发跳过空白
+class SpanStream {
+public:
+    using Ch = char;
+
+    explicit SpanStream(std::string_view input)
+        : begin_(input.data()), cur_(input.data()), end_(input.data() + input.size()) {}
+
+    [[nodiscard]] auto Peek() const -> Ch { return cur_ == end_ ? '\0' : *cur_; } // NOLINT
+
+    auto Take() -> Ch { return cur_ == end_ ? '\0' : *cur_++; } // NOLINT
+
+    [[nodiscard]] auto Tell() const -> size_t { // NOLINT
+        return static_cast<size_t>(cur_ - begin_);
+    }
+
+    // 只读, 写接口只在原地解析时用到
+    auto PutBegin() -> Ch* { // NOLINT
+        RAPIDJSON_ASSERT(false);
+        return nullptr;
+    }
+
+    void Put(Ch /*c*/) { RAPIDJSON_ASSERT(false); } // NOLINT
+
+    void Flush() { RAPIDJSON_ASSERT(false); } // NOLINT
+
+    auto PutEnd(Ch* /*begin*/) -> size_t { // NOLINT
+        RAPIDJSON_ASSERT(false);
+        return 0;
+    }
+
+    [[nodiscard]] auto pos() const -> const char* { return cur_; }
+
+    [[nodiscard]] auto end() const -> const char* { return end_; }
+
+    void seek(const char* p) { cur_ = p; }
+
+private:
+    const char* begin_;
+    const char* cur_;
+    const char* end_;
+};
+
+inline void SkipWhitespace(SpanStream& stream) { // NOLINT(readability-identifier-naming)
+    stream.seek(detail::skip_ws(stream.pos(), stream.end()));
+}
+
+// 拉取式解析: 每次 next() 让 Reader 只前进一个 token
+template <typename Stream, unsigned Flags = rapidjson::kParseDefaultFlags>
+class Cursor {
+public:
+    // 原地解析时字符串指向输入本身, 在输入销毁前一直有效
+    static constexpr bool kInsitu = (Flags & rapidjson::kParseInsituFlag) != 0;
+    // 快速路径自己扫字符串, 不做编码校验
+    static constexpr bool kFastArrays =
+        std::is_same_v<Stream, SpanStream> && (Flags & rapidjson::kParseValidateEncodingFlag) == 0;
+    // 快速路径的浮点数总是正确舍入, 只有 Reader 也这样做时才接管浮点数组
+    static constexpr bool kFullPrecision = (Flags & rapidjson::kParseFullPrecisionFlag) != 0;
+
+    Cursor(rapidjson::Reader& reader, Stream& stream) : reader_(reader), stream_(stream) {
+        reader_.IterativeParseInit();
+    }
+
+    // 输入结束或语法错误时返回 false
+    auto next() -> bool {
+        if (reader_.IterativeParseComplete()) {
+            return false;
+        }
+        return reader_.template IterativeParseNext<Flags>(stream_, event_);
+    }
+
+    [[nodiscard]] auto event() const -> const Event& { return event_; }
+
+    // 快速路径绕过 Reader 直接读输入
+    [[nodiscard]] auto stream() -> Stream& { return stream_; }
+
+    // 当前 token 是 [ 或 { 时跳过整个值, 标量不需要额外动作
+    auto skip() -> bool {
+        size_t depth = 0;
+        do {
+            switch (event_.token) {
+                case Token::START_OBJECT:
+                case Token::START_ARRAY:
+                    ++depth;
+                    break;
+                case Token::END_OBJECT:
+                case Token::END_ARRAY:
+                    --depth;
+                    break;
+                default:
+                    break;
+            }
+            if (depth == 0) {
+                return true;
+            }
+        } while (next());
+        return false;
+    }
+
+    // 根节点已经读完且后面没有多余内容
+    [[nodiscard]] auto done() const -> bool {
+        return reader_.IterativeParseComplete() && !reader_.HasParseError();
+    }
+
+private:
+    rapidjson::Reader& reader_;
+    Stream& stream_;
+    Event event_;
+};
+
+namespace detail {
+
+constexpr auto hash_key(std::string_view key, uint64_t seed) -> uint64_t {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (char c : key) {
+        h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return h ^ (h >> 32U);
+}
+
+// 字段名 -> 下标. 槽位数取 N^2 向上到 2 的幂, 随机种子无冲突的概率过半,
+// 编译期通常试一两个种子就能找到
+template <size_t N>
+struct PerfectHash {
+    static_assert(N <= 128, "too many JSON fields for a perfect hash table");
+
+    static constexpr size_t kSlots = std::bit_ceil(std::max<size_t>(N * N, 1));
+
+    uint64_t seed = 0;
+    // 字段下标 + 1, 0 表示空槽
+    std::array<uint8_t, kSlots> slots{};
+    std::array<std::string_view, N> names{};
+
+    [[nodiscard]] constexpr auto find(std::string_view key) const -> int {
+        if constexpr (N == 0) {
+            return -1;
+        } else {
+            const uint8_t slot = slots[hash_key(key, seed) & (kSlots - 1)];
+            return slot != 0 && names[slot - 1] == key ? slot - 1 : -1;
+        }
+    }
+};
+
+template <size_t N>
+consteval auto make_perfect_hash(const std::array<std::string_view, N>& names) -> PerfectHash<N> {
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i + 1; j < N; ++j) {
+            if (names[i] == names[j]) {
+                throw "duplicate JSON field name";
+            }
+        }
+    }
+    for (uint64_t seed = 0; seed < 4096; ++seed) {
+        PerfectHash<N> table;
+        table.seed = seed;
+        table.names = names;
+        bool ok = true;
+        for (size_t i = 0; i < N && ok; ++i) {
+            auto& slot = table.slots[hash_key(names[i], seed) & (PerfectHash<N>::kSlots - 1)];
+            ok = slot == 0;
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        if (ok) {
+            return table;
+        }
+    }
+    throw "no perfect hash found for JSON field names";
+}
+
+template <Reflected T>
+struct Schema {
+    static constexpr auto fields = T::json_fields();
+    static constexpr size_t size = std::tuple_size_v<decltype(fields)>;
+    static constexpr auto index = make_perfect_hash(std::apply(
+        [](const auto&... f) -> std::array<std::string_view, size> { return {f.name...}; },
+        fields));
+};
+
+// 数值类型不匹配或越界时返回 false, 不修改 out
+template <typename T>
+auto assign_number(const Event& e, T& out) -> bool {
+    if constexpr (std::is_floating_point_v<T>) {
+        switch (e.token) {
+            case Token::DOUBLE:
+                out = static_cast<T>(e.d);
+                return true;
+            case Token::INT:
+                out = static_cast<T>(e.i);
+                return true;
+            case Token::UINT:
+                out = static_cast<T>(e.u);
+                return true;
+            default:
+                return false;
+        }
+    } else {
+        if (e.token == Token::INT && std::in_range<T>(e.i)) {
+            out = static_cast<T>(e.i);
+            return true;
+        }
+        if (e.token == Token::UINT && std::in_range<T>(e.u)) {
+            out = static_cast<T>(e.u);
+            return true;
+        }
+        return false;
+    }
+}
+
+template <typename C, typename T>
+auto read_value(C& cursor, T& out) -> bool;
+
+template <typename C, typename T, size_t I>
+auto read_member(C& cursor, T& out) -> bool {
+    return read_value(cursor, out.*(std::get<I>(Schema<T>::fields).member));
+}
+
+// 下标到成员的跳转表, 每个类型一份
+template <typename C, typename T, size_t... I>
+auto read_member_at(C& cursor, T& out, size_t idx, std::index_sequence<I...> /*seq*/) -> bool {
+    using Fn = auto (*)(C&, T&) -> bool;
+    static constexpr std::array<Fn, sizeof...(I)> table = {&read_member<C, T, I>...};
+    return table[idx](cursor, out);
+}
+
+template <typename C, typename T>
+auto read_object(C& cursor, T& out) -> bool {
+    using S = Schema<T>;
+    while (cursor.next()) {
+        if (cursor.event().token == Token::END_OBJECT) {
+            return true;
+        }
+        // key 指向 Reader 的栈, 必须在 next() 之前查完
+        const int idx = S::index.find(cursor.event().str);
+        if (!cursor.next()) {
+            return false;
+        }
+        const bool ok = idx < 0 ? cursor.skip()
+                                : read_member_at(
+                                      cursor,
+                                      out,
+                                      static_cast<size_t>(idx),
+                                      std::make_index_sequence<S::size>{});
+        if (!ok) {
+            return false;
+        }
+    }
+    return false;
+}
+
+template <typename C, typename T>
+auto read_map(C& cursor, T& out) -> bool {
+    using K = typename T::key_type;
+    out.clear();
+    while (cursor.next()) {
+        const Event& e = cursor.event();
+        if (e.token == Token::END_OBJECT) {
+            return true;
+        }
+        typename T::mapped_type* slot = nullptr;
+        if constexpr (std::is_integral_v<K>) {
+            K key{};
+            const auto [ptr, ec] = std::from_chars(e.str.data(), e.str.data() + e.str.size(), key);
+            if (ec == std::errc() && ptr == e.str.data() + e.str.size()) {
+                slot = &out[key];
+            }
+        } else {
+            static_assert(
+                !std::is_same_v<K, std::string_view> || C::kInsitu,
+                "std::string_view keys can only be read by from_json_insitu");
+            slot = &out[K(e.str)];
+        }
+        if (!cursor.next() || !(slot != nullptr ? read_value(cursor, *slot) : cursor.skip())) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// 小端机器上一次检查 / 转换 8 个 ASCII 数字 (SWAR)
+constexpr auto is_eight_digits(uint64_t v) -> bool {
+    return (((v + 0x4646464646464646ULL) | (v - 0x3030303030303030ULL)) & 0x8080808080808080ULL) ==
+           0;
+}
+
+constexpr auto parse_eight_digits(uint64_t v) -> uint32_t {
+    constexpr uint64_t kMask = 0x000000FF000000FFULL;
+    constexpr uint64_t kMul1 = 100 + (1000000ULL << 32U);
+    constexpr uint64_t kMul2 = 1 + (10000ULL << 32U);
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8U);
+    v = (((v & kMask) * kMul1) + (((v >> 16U) & kMask) * kMul2)) >> 32U;
+    return static_cast<uint32_t>(v);
+}
+
+constexpr auto is_digit(char c) -> bool {
+    return c >= '0' && c <= '9';
+}
+
+// 按 JSON 语法读一个整数, 返回数字之后的位置. 前导 0, 小数点和指数由调用方发现后面
+// 不是 , 或 ] 而放弃; 超过 19 位或超出 V 的范围返回 nullptr
+template <typename V>
+auto scan_integer(const char* p, const char* end, V& out) -> const char* {
+    const bool negative = p != end && *p == '-';
+    if (negative) {
+        ++p;
+    }
+    const char* digits = p;
+    uint64_t magnitude = 0;
+    if (p != end && *p == '0') {
+        ++p;
+    } else {
+        if constexpr (std::endian::native == std::endian::little) {
+            while (end - p >= 8) {
+                uint64_t chunk = 0;
+                std::memcpy(&chunk, p, sizeof(chunk));
+                if (!is_eight_digits(chunk)) {
+                    break;
+                }
+                magnitude = (magnitude * 100000000U) + parse_eight_digits(chunk);
+                p += 8;
+            }
+        }
+        for (; p != end && is_digit(*p); ++p) {
+            magnitude = (magnitude * 10) + static_cast<uint64_t>(*p - '0');
+        }
+    }
+
+    const auto count = p - digits;
+    if (count == 0 || count > 19) {
+        return nullptr;
+    }
+    if (negative) {
+        if (magnitude > (uint64_t{1} << 63U)) {
+            return nullptr;
+        }
+        const auto v = static_cast<int64_t>(0 - magnitude);
+        if (!std::in_range<V>(v)) {
+            return nullptr;
+        }
+        out = static_cast<V>(v);
+    } else {
+        if (!std::in_range<V>(magnitude)) {
+            return nullptr;
+        }
+        out = static_cast<V>(magnitude);
+    }
+    return p;
+}
+
+// 先按 JSON 语法找到数字的边界, 再交给 from_chars (正确舍入, 不受 locale 影响).
+// 和 Reader 的结果一致要求 kParseFullPrecisionFlag. 溢出到无穷的数返回 nullptr
+template <typename V>
+auto scan_double(const char* p, const char* end, V& out) -> const char* {
+    const char* begin = p;
+    if (p != end && *p == '-') {
+        ++p;
+    }
+    if (p == end || !is_digit(*p)) {
+        return nullptr;
+    }
+    if (*p == '0') {
+        ++p;
+    } else {
+        while (p != end && is_digit(*p)) {
+            ++p;
+        }
+    }
+    if (p != end && *p == '.') {
+        const char* fraction = ++p;
+        while (p != end && is_digit(*p)) {
+            ++p;
+        }
+        if (p == fraction) {
+            return nullptr;
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p != end && (*p == '+' || *p == '-')) {
+            ++p;
+        }
+        const char* exponent = p;
+        while (p != end && is_digit(*p)) {
+            ++p;
+        }
+        if (p == exponent) {
+            return nullptr;
+        }
+    }
+
+    double v = 0;
+    const auto [ptr, ec] = std::from_chars(begin, p, v);
+    if (ec != std::errc() || ptr != p) {
+        return nullptr;
+    }
+    out = static_cast<V>(v);
+    return p;
+}
+
+template <typename V, bool FullPrecision>
+concept FastElement = (std::is_integral_v<V> && !std::is_same_v<V, bool>)
+                      || (std::is_floating_point_v<V> && FullPrecision)
+                      || std::is_same_v<V, std::string>;
+
+// 元素全是数字或全是字符串的数组 (spuids 之类) 直接扫描输入, 不经过 Reader 逐个 token
+// 回调. 成功时 stream 停在 ] 上, Reader 接着看到的就是一个空数组. 遇到其他情况 (null,
+// 嵌套, 类型不符, 越界, 语法错误) 清空 out 并返回 false, stream 不动, 由 Reader 重新解析
+template <typename T>
+auto read_array_fast(SpanStream& stream, T& out) -> bool {
+    using V = std::ranges::range_value_t<T>;
+    const char* const end = stream.end();
+    const char* p = skip_ws(stream.pos(), end);
+    while (p != end) {
+        V v{};
+        if constexpr (std::is_same_v<V, std::string>) {
+            p = scan_quoted(p, end, v);
+        } else if constexpr (std::is_integral_v<V>) {
+            p = scan_integer(p, end, v);
+        } else {
+            p = scan_double(p, end, v);
+        }
+        if (p == nullptr) {
+            break;
+        }
+        out.push_back(std::move(v));
+
+        p = skip_ws(p, end);
+        if (p == end || (*p != ',' && *p != ']')) {
+            break;
+        }
+        if (*p == ']') {
+            stream.seek(p);
+            return true;
+        }
+        p = skip_ws(p + 1, end);
+    }
+    out.clear();
+    return false;
+}
+
+template <typename C, typename T>
+auto read_array(C& cursor, T& out) -> bool {
+    using V = std::ranges::range_value_t<T>;
+    out.clear();
+    if constexpr (C::kFastArrays && FastElement<V, C::kFullPrecision>) {
+        if (fast_paths.load(std::memory_order_relaxed)) {
+            // 成功时下面的循环只会读到 ]
+            read_array_fast(cursor.stream(), out);
+        }
+    }
+    while (cursor.next()) {
+        if (cursor.event().token == Token::END_ARRAY) {
+            return true;
+        }
+        if constexpr (std::is_same_v<decltype(out.emplace_back()), V&>) {
+            if (!read_value(cursor, out.emplace_back())) {
+                return false;
+            }
+        } else {
+            // vector<bool> 之类的代理引用
+            V v{};
+            if (!read_value(cursor, v)) {
+                return false;
+            }
+            out.push_back(v);
+        }
+    }
+    return false;
+}
+
+// 调用时 cursor 停在值的第一个 token 上, 返回时停在值的最后一个 token 上
+template <typename C, typename T>
+auto read_value(C& cursor, T& out) -> bool {
+    const Event& e = cursor.event();
+    if constexpr (std::is_same_v<T, bool>) {
+        if (e.token == Token::BOOL) {
+            out = e.b;
+        }
+    } else if constexpr (std::is_enum_v<T>) {
+        std::underlying_type_t<T> v{};
+        if (assign_number(e, v)) {
+            out = static_cast<T>(v);
+        }
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        assign_number(e, out);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        if (e.token == Token::STRING) {
+            out.assign(e.str);
+        }
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        static_assert(C::kInsitu, "std::string_view fields can only be read by from_json_insitu");
+        if (e.token == Token::STRING) {
+            out = e.str;
+        }
+    } else if constexpr (IsOptional<T>::value) {
+        if (e.token == Token::NUL) {
+            out.reset();
+            return true;
+        }
+        if (!out) {
+            out.emplace();
+        }
+        return read_value(cursor, *out);
+    } else if constexpr (Reflected<T>) {
+        if (e.token == Token::START_OBJECT) {
+            return read_object(cursor, out);
+        }
+    } else if constexpr (MapLike<T>) {
+        if (e.token == Token::START_OBJECT) {
+            return read_map(cursor, out);
+        }
+    } else if constexpr (requires { out.emplace_back(); }) {
+        if (e.token == Token::START_ARRAY) {
+            return read_array(cursor, out);
+        }
+    } else {
+        static_assert(always_false_v<T>, "Unsupported type for JSON deserialization");
+    }
+    return cursor.skip();
+}
+
+} // namespace detail
+
+namespace detail {
+
+// Reader 每个线程复用一个, 稳定后解析字符串不再分配内存
+inline auto local_reader() -> std::optional<rapidjson::Reader>& {
+    thread_local std::optional<rapidjson::Reader> reader;
+    return reader;
+}
+
+template <unsigned Flags, typename Stream, typename T>
+auto parse(Stream& stream, T& out) -> bool {
+    auto& reader = local_reader();
+    if (!reader) {
+        reader.emplace();
+    }
+
+    // 成员类型不对时跳过, 但根不是对象说明整个输入就不是这条记录
+    Cursor<Stream, Flags> cursor(*reader, stream);
+    const bool ok = cursor.next() && cursor.event().token == Token::START_OBJECT
+                    && read_value(cursor, out) && cursor.done();
+    if (!ok) {
+        // 出错时 Reader 的栈里可能残留半个字符串, 换一个干净的
+        reader.reset();
+    }
+    return ok;
+}
+
+} // namespace detail
+
+// 解析失败 (语法错误, 多余内容, 根不是对象) 返回 false, 此时 out 可能只填了一部分
+template <unsigned Flags = rapidjson::kParseDefaultFlags, Reflected T>
+auto from_json(std::string_view input, T& out) -> bool {
+    SpanStream stream(input);
+    return detail::parse<Flags>(stream, out);
+}
+
+// 在 buffer 上原地解析: 转义就地还原, 字符串不再拷贝. buffer 的内容会被改写,
+// out 里的 std::string_view 指向 buffer, 使用期间 buffer 不能销毁或修改
+template <unsigned Flags = rapidjson::kParseDefaultFlags, Reflected T>
+auto from_json_insitu(std::string& buffer, T& out) -> bool {
+    rapidjson::InsituStringStream stream(buffer.data());
+    return detail::parse<Flags | rapidjson::kParseInsituFlag>(stream, out);
+}
+
+} // namespace json
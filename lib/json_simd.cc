@@ -0,0 +1,323 @@
+#include "lib/json.h"
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+#include "lib/meta.h"
+
+namespace json {
+
+namespace {
+
+using ScanFn = auto (*)(const char*, const char*) -> const char*;
+
+struct Kernels {
+    std::string_view name;
+    ScanFn skip_space;
+    ScanFn scan_string;
+};
+
+constexpr auto is_space(char c) -> bool {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+constexpr auto is_special(char c) -> bool {
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+auto skip_space_scalar(const char* p, const char* end) -> const char* {
+    while (p != end && is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+auto scan_string_scalar(const char* p, const char* end) -> const char* {
+    while (p != end && !is_special(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// 剩余不足一个向量宽度时都交给标量版本, 不会读到 end 之后
+#if defined(__x86_64__)
+
+// SSE2 属于 x86-64 基础指令集, 不需要检测
+auto skip_space_sse2(const char* p, const char* end) -> const char* {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; end - p >= 16; p += 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); // NOLINT
+        const __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(s, space), _mm_cmpeq_epi8(s, lf)),
+            _mm_or_si128(_mm_cmpeq_epi8(s, cr), _mm_cmpeq_epi8(s, tab)));
+        const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(ws)) ^ 0xFFFFU;
+        if (mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+    return skip_space_scalar(p, end);
+}
+
+auto scan_string_sse2(const char* p, const char* end) -> const char* {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); // NOLINT
+        // 无符号比较 s <= 0x1F 等价于 min(s, 0x1F) == s
+        const __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(s, quote), _mm_cmpeq_epi8(s, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(s, control), s));
+        const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+        if (mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+    return scan_string_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) auto skip_space_avx2(const char* p, const char* end)
+    -> const char* {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    for (; end - p >= 32; p += 32) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); // NOLINT
+        const __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, space), _mm256_cmpeq_epi8(s, lf)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, cr), _mm256_cmpeq_epi8(s, tab)));
+        const auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+        if (mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+    return skip_space_sse2(p, end);
+}
+
+__attribute__((target("avx2"))) auto scan_string_avx2(const char* p, const char* end)
+    -> const char* {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); // NOLINT
+        const __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, quote), _mm256_cmpeq_epi8(s, backslash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(s, control), s));
+        const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return p + std::countr_zero(mask);
+        }
+    }
+    return scan_string_sse2(p, end);
+}
+
+#elif defined(__ARM_NEON)
+
+// NEON 没有 movemask: 每个字节收窄成 4 位, 64 位里第一个置位的 nibble 就是第一个命中的字节
+auto first_hit(uint8x16_t hit) -> int {
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(hit), 4);
+    const uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    return bits == 0 ? -1 : std::countr_zero(bits) >> 2;
+}
+
+auto skip_space_neon(const char* p, const char* end) -> const char* {
+    for (; end - p >= 16; p += 16) {
+        const uint8x16_t s = vld1q_u8(reinterpret_cast<const uint8_t*>(p)); // NOLINT
+        const uint8x16_t ws = vorrq_u8(
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8(' ')), vceqq_u8(s, vdupq_n_u8('\n'))),
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8('\r')), vceqq_u8(s, vdupq_n_u8('\t'))));
+        const int i = first_hit(vmvnq_u8(ws));
+        if (i >= 0) {
+            return p + i;
+        }
+    }
+    return skip_space_scalar(p, end);
+}
+
+auto scan_string_neon(const char* p, const char* end) -> const char* {
+    for (; end - p >= 16; p += 16) {
+        const uint8x16_t s = vld1q_u8(reinterpret_cast<const uint8_t*>(p)); // NOLINT
+        const uint8x16_t hit = vorrq_u8(
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8('"')), vceqq_u8(s, vdupq_n_u8('\\'))),
+            vcleq_u8(s, vdupq_n_u8(0x1F)));
+        const int i = first_hit(hit);
+        if (i >= 0) {
+            return p + i;
+        }
+    }
+    return scan_string_scalar(p, end);
+}
+
+#endif
+
+constexpr Kernels kScalar{"scalar", skip_space_scalar, scan_string_scalar};
+#if defined(__x86_64__)
+constexpr Kernels kSse2{"sse2", skip_space_sse2, scan_string_sse2};
+constexpr Kernels kAvx2{"avx2", skip_space_avx2, scan_string_avx2};
+#elif defined(__ARM_NEON)
+constexpr Kernels kNeon{"neon", skip_space_neon, scan_string_neon};
+#endif
+
+// 第一次调用时按 CPU 特性选定
+auto best_kernels() -> const Kernels& {
+    static const Kernels* const kernels = select_kernel<const Kernels*>({
+#if defined(__x86_64__)
+        {CpuInfo::get().isa.avx2, &kAvx2},
+        {true, &kSse2},
+#elif defined(__ARM_NEON)
+        {CpuInfo::get().isa.neon, &kNeon},
+#endif
+        {true, &kScalar},
+    });
+    return *kernels;
+}
+
+auto kernels() -> const Kernels& {
+    return detail::fast_paths.load(std::memory_order_relaxed) ? best_kernels() : kScalar;
+}
+
+auto hex4(const char* p, const char* end, uint32_t& out) -> bool {
+    if (end - p < 4) {
+        return false;
+    }
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        uint32_t digit = 0;
+        if (c >= '0' && c <= '9') {
+            digit = static_cast<uint32_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = static_cast<uint32_t>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = static_cast<uint32_t>(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        out = (out << 4U) | digit;
+    }
+    return true;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0U | (cp >> 6U)));
+        out.push_back(static_cast<char>(0x80U | (cp & 0x3FU)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0U | (cp >> 12U)));
+        out.push_back(static_cast<char>(0x80U | ((cp >> 6U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | (cp & 0x3FU)));
+    } else {
+        out.push_back(static_cast<char>(0xF0U | (cp >> 18U)));
+        out.push_back(static_cast<char>(0x80U | ((cp >> 12U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | ((cp >> 6U) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | (cp & 0x3FU)));
+    }
+}
+
+// p 指向 \u 之后的 4 个十六进制数字, 代理项必须成对出现. 返回转义之后的位置
+auto unescape_unicode(const char* p, const char* end, std::string& out) -> const char* {
+    uint32_t cp = 0;
+    if (!hex4(p, end, cp)) {
+        return nullptr;
+    }
+    p += 4;
+    if (cp >= 0xD800 && cp <= 0xDFFF) {
+        uint32_t low = 0;
+        if (cp > 0xDBFF || end - p < 2 || p[0] != '\\' || p[1] != 'u' ||
+            !hex4(p + 2, end, low) || low < 0xDC00 || low > 0xDFFF) {
+            return nullptr;
+        }
+        cp = 0x10000 + ((cp - 0xD800) << 10U) + (low - 0xDC00);
+        p += 6;
+    }
+    append_utf8(out, cp);
+    return p;
+}
+
+} // namespace
+
+auto simd_name() -> std::string_view {
+    return best_kernels().name;
+}
+
+namespace detail {
+
+auto skip_space(const char* p, const char* end) -> const char* {
+    return kernels().skip_space(p, end);
+}
+
+auto scan_string(const char* p, const char* end) -> const char* {
+    return kernels().scan_string(p, end);
+}
+
+auto scan_quoted(const char* p, const char* end, std::string& out) -> const char* {
+    if (p == end || *p != '"') {
+        return nullptr;
+    }
+    const ScanFn scan = kernels().scan_string;
+    ++p;
+    while (true) {
+        const char* q = scan(p, end);
+        out.append(p, q);
+        if (q == end || static_cast<unsigned char>(*q) < 0x20) {
+            return nullptr;
+        }
+        if (*q == '"') {
+            return q + 1;
+        }
+        // 反斜杠
+        if (end - q < 2) {
+            return nullptr;
+        }
+        p = q + 2;
+        switch (q[1]) {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(q[1]);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+                p = unescape_unicode(p, end, out);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                break;
+            default:
+                return nullptr;
+        }
+    }
+}
+
+} // namespace detail
+
+} // namespace json
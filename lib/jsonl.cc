@@ -0,0 +1,139 @@
+#include "lib/jsonl.h"
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace json {
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), "stat " + path);
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        addr_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr_ == MAP_FAILED) {
+            const int err = errno;
+            addr_ = nullptr;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "mmap " + path);
+        }
+        // 每个线程顺序扫自己的 chunk, 读过的页不会再用
+        ::madvise(addr_, size_, MADV_SEQUENTIAL);
+    }
+    // 映射建立后 fd 就不需要了
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (addr_ != nullptr) {
+        ::munmap(addr_, size_);
+    }
+}
+
+auto split_chunks(std::string_view data, size_t chunk_size) -> std::vector<std::string_view> {
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    std::vector<std::string_view> chunks;
+    chunks.reserve(data.size() / chunk_size + 1);
+    while (!data.empty()) {
+        size_t end = std::min(chunk_size, data.size());
+        if (end < data.size()) {
+            // 把 end - 1 所在的那一行整行划进来
+            const size_t newline = data.find('\n', end - 1);
+            end = newline == std::string_view::npos ? data.size() : newline + 1;
+        }
+        chunks.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+    }
+    return chunks;
+}
+
+namespace detail {
+
+void run_chunks(
+    std::span<const std::string_view> chunks,
+    size_t threads,
+    bool ordered,
+    const std::function<void(size_t, size_t, std::string_view)>& parse,
+    const std::function<void(size_t, size_t)>& deliver) {
+    std::atomic<size_t> next{0};
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    // 有序模式下下一个该交付的 chunk
+    size_t turn = 0;
+    bool failed = false;
+    std::exception_ptr error;
+
+    auto work = [&](size_t worker) -> void {
+        try {
+            for (size_t i = next.fetch_add(1); i < chunks.size(); i = next.fetch_add(1)) {
+                parse(worker, i, chunks[i]);
+                if (!ordered) {
+                    deliver(worker, i);
+                    continue;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] -> bool { return turn == i || failed; });
+                    if (failed) {
+                        return;
+                    }
+                }
+                deliver(worker, i);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++turn;
+                }
+                cv.notify_all();
+            }
+        } catch (...) {
+            // 停止分发新 chunk, 并唤醒所有在等交付顺序的线程
+            next.store(chunks.size());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+            cv.notify_all();
+        }
+    };
+
+    {
+        std::vector<std::jthread> pool;
+        pool.reserve(threads - 1);
+        for (size_t w = 1; w < threads; ++w) {
+            pool.emplace_back(work, w);
+        }
+        work(0);
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace detail
+
+} // namespace json
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "lib/json.h"
+
+// JSON-lines 文件的并行读取: mmap 整个文件, 按换行切成若干 chunk, 多个线程各自解析
+// 一个 chunk 里的所有行, 再把这一批记录交给 consumer.
+//
+//   json::read_lines<Item>(path, [](size_t chunk, std::span<Item> items) -> void { ... });
+
+namespace json {
+
+struct LinesOptions {
+    // 解析线程数, 包括调用线程
+    size_t threads = std::max(1U, std::thread::hardware_concurrency());
+    // chunk 的目标大小, 实际边界顺延到下一个换行
+    size_t chunk_size = 4U << 20;
+    // true: consumer 按 chunk 在文件中的顺序串行调用
+    // false: 每个线程解析完立即调用, consumer 需要自己保证线程安全
+    bool ordered = true;
+};
+
+struct LinesStats {
+    size_t bytes = 0;
+    size_t chunks = 0;
+    size_t records = 0;
+    // 解析失败被跳过的行
+    size_t bad_lines = 0;
+};
+
+// 只读映射整个文件, 打开失败抛 std::system_error
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+    auto operator=(MappedFile&&) -> MappedFile& = delete;
+
+    ~MappedFile();
+
+    [[nodiscard]] auto data() const -> std::string_view {
+        return {static_cast<const char*>(addr_), size_};
+    }
+
+private:
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 按 chunk_size 切分, 每个 chunk 都以完整的行结束
+[[nodiscard]] auto split_chunks(std::string_view data, size_t chunk_size)
+    -> std::vector<std::string_view>;
+
+// 逐行回调, 去掉行尾的 \r, 跳过空白行
+template <typename Fn>
+void for_each_line(std::string_view chunk, Fn&& fn) {
+    while (!chunk.empty()) {
+        const size_t end = chunk.find('\n');
+        std::string_view line = chunk.substr(0, end);
+        chunk.remove_prefix(end == std::string_view::npos ? chunk.size() : end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") != std::string_view::npos) {
+            fn(line);
+        }
+    }
+}
+
+namespace detail {
+
+// 在 threads 个线程 (含调用线程) 上处理 chunks. parse(worker, index, chunk) 并行执行;
+// 有序模式下 deliver(worker, index) 按 index 顺序串行执行, 同一个 worker 交付完之前不会取
+// 新的 chunk, 所以在途的结果最多 threads 份. 任一回调抛出的第一个异常在全部线程退出后重新抛出
+void run_chunks(
+    std::span<const std::string_view> chunks,
+    size_t threads,
+    bool ordered,
+    const std::function<void(size_t, size_t, std::string_view)>& parse,
+    const std::function<void(size_t, size_t)>& deliver);
+
+} // namespace detail
+
+// 每个 chunk 解析出的记录一起交给 consumer(chunk_index, std::span<T>). 空 chunk 也会回调.
+// span 指向线程内复用的缓冲区, consumer 可以移走其中的元素, 返回后缓冲区被清空
+template <Reflected T, typename Consumer>
+auto read_lines(const std::string& path, Consumer&& consumer, const LinesOptions& opts = {})
+    -> LinesStats {
+    const MappedFile file(path);
+    const auto chunks = split_chunks(file.data(), opts.chunk_size);
+    const size_t threads = std::clamp<size_t>(opts.threads, 1, std::max<size_t>(chunks.size(), 1));
+
+    struct alignas(64) Worker {
+        std::vector<T> records;
+        size_t delivered = 0;
+        size_t bad_lines = 0;
+    };
+    std::vector<Worker> workers(threads);
+
+    detail::run_chunks(
+        chunks,
+        threads,
+        opts.ordered,
+        [&workers](size_t w, size_t /*index*/, std::string_view chunk) -> void {
+            auto& worker = workers[w];
+            for_each_line(chunk, [&worker](std::string_view line) -> void {
+                if (!from_json(line, worker.records.emplace_back())) {
+                    worker.records.pop_back();
+                    ++worker.bad_lines;
+                }
+            });
+        },
+        [&workers, &consumer](size_t w, size_t index) -> void {
+            auto& worker = workers[w];
+            worker.delivered += worker.records.size();
+            consumer(index, std::span<T>(worker.records));
+            worker.records.clear();
+        });
+
+    LinesStats stats;
+    stats.bytes = file.data().size();
+    stats.chunks = chunks.size();
+    for (const auto& worker : workers) {
+        stats.records += worker.delivered;
+        stats.bad_lines += worker.bad_lines;
+    }
+    return stats;
+}
+
+} // namespace json
@@ -0,0 +1,1273 @@
+#include "lib/log.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "rapidjson/writer.h"
+
+namespace {
+
+// 单生产者单消费者的字节 ring, 记录格式为 [u32 len][payload], 按 8 字节对齐.
+// 记录不会跨越尾部, 空间不够时写一个 PAD 标记跳回开头, 消费方可以直接拿到连续内存.
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 4096))),
+          mask_(capacity_ - 1),
+          data_(std::make_unique<char[]>(capacity_)) {}
+
+    // 写入一条记录, 空间不足返回 false
+    auto try_push(std::string_view record) -> bool {
+        char* dst = reserve(static_cast<uint32_t>(record.size()));
+        if (dst == nullptr) {
+            return false;
+        }
+        std::memcpy(dst, record.data(), record.size());
+        commit();
+        return true;
+    }
+
+    // 预留 len 字节的连续空间, 写完后调用 commit()
+    auto reserve(uint32_t len) -> char* {
+        const uint64_t need = align(sizeof(uint32_t) + len);
+        if (need > capacity_ / 2) {
+            return nullptr;
+        }
+
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t pos = tail & mask_;
+        const uint64_t contiguous = capacity_ - pos;
+        const uint64_t total = need + (contiguous < need ? contiguous : 0);
+
+        if (capacity_ - (tail - head) < total) {
+            return nullptr;
+        }
+
+        if (contiguous < need) {
+            std::memcpy(&data_[pos], &kPad, sizeof(kPad));
+            tail += contiguous;
+        }
+
+        char* dst = &data_[tail & mask_];
+        std::memcpy(dst, &len, sizeof(len));
+        pending_tail_ = tail + need;
+        return dst + sizeof(uint32_t);
+    }
+
+    void commit() { tail_.store(pending_tail_, std::memory_order_release); }
+
+    // 依次回调所有可读记录, 返回处理的条数
+    template <typename F>
+    auto consume(F&& fn) -> size_t {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+        size_t count = 0;
+
+        while (head != tail) {
+            const uint64_t pos = head & mask_;
+            uint32_t len = 0;
+            std::memcpy(&len, &data_[pos], sizeof(len));
+            if (len == kPad) {
+                head += capacity_ - pos;
+                continue;
+            }
+            fn(std::string_view(&data_[pos + sizeof(uint32_t)], len));
+            head += align(sizeof(uint32_t) + len);
+            ++count;
+        }
+
+        head_.store(head, std::memory_order_release);
+        return count;
+    }
+
+    [[nodiscard]] auto used() const -> uint64_t {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto capacity() const -> uint64_t { return capacity_; }
+
+    [[nodiscard]] auto empty() const -> bool { return used() == 0; }
+
+    std::atomic<bool> closed{false};
+    // 生产者线程的 id, 后台线程格式化延迟记录时使用
+    std::string tid;
+    // 进程内单调递增的序号, 二进制落盘时标识线程. 不用地址: ring 回收后地址可能被新 ring 复用
+    uint64_t id = 0;
+
+private:
+    static constexpr uint32_t kPad = UINT32_MAX;
+
+    static constexpr auto align(uint64_t n) -> uint64_t { return (n + 7) & ~uint64_t{7}; }
+
+    const uint64_t capacity_;
+    const uint64_t mask_;
+    std::unique_ptr<char[]> data_;
+    uint64_t pending_tail_ = 0;
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+};
+
+void write_fd(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+auto thread_id_str() -> std::string {
+    std::ostringstream oss;
+    oss << std::this_thread::get_id();
+    return oss.str();
+}
+
+auto level_name(LogLevel level) -> const char* {
+    switch (level) {
+        case LogLevel::TRACE:
+            return "TRACE";
+        case LogLevel::DEBUG:
+            return "DEBUG";
+        case LogLevel::INFO:
+            return "INFO";
+        case LogLevel::WARN:
+            return "WARN";
+        case LogLevel::ERROR:
+            return "ERROR";
+    }
+    return "";
+}
+
+void format_line(
+    std::string& out,
+    LogLevel level,
+    std::chrono::time_point<std::chrono::system_clock> now,
+    std::string_view tid,
+    std::string_view file,
+    uint32_t line,
+    std::string_view message,
+    bool colored,
+    std::span<const logging::Field> fields) {
+    // 简单的颜色代码
+    const char* color_code = "";
+    const char* level_str = level_name(level);
+
+    switch (level) {
+        case LogLevel::TRACE:
+        case LogLevel::DEBUG:
+        case LogLevel::INFO:
+            color_code = "\033[32m";
+            break;
+        case LogLevel::WARN:
+            color_code = "\033[33m";
+            break;
+        case LogLevel::ERROR:
+            color_code = "\033[31m";
+            break;
+    }
+    const char* reset_code = "\033[0m";
+    if (!colored) {
+        color_code = "";
+        reset_code = "";
+    }
+
+    // {:%F %T} 是 YYYY-MM-DD HH:MM:SS 格式, 同一秒内的记录复用上次的结果
+    struct TimeCache {
+        int64_t sec = INT64_MIN;
+        std::string text;
+    };
+    thread_local TimeCache cache;
+
+    const auto sec = std::chrono::floor<std::chrono::seconds>(now);
+    if (sec.time_since_epoch().count() != cache.sec) {
+        cache.sec = sec.time_since_epoch().count();
+        cache.text.clear();
+        std::format_to(std::back_inserter(cache.text), "{:%F %T}", sec);
+    }
+
+    std::array<char, 16> line_buf{};
+    const auto res = std::to_chars(line_buf.data(), line_buf.data() + line_buf.size(), line);
+
+    // [时间] [线程] [等级] [文件:行号] 消息
+    out.append(color_code);
+    out.push_back('[');
+    out.append(cache.text);
+    out.append("] [");
+    out.append(tid);
+    out.append("] [");
+    out.append(level_str);
+    out.append("] [");
+    out.append(file);
+    out.push_back(':');
+    out.append(line_buf.data(), res.ptr);
+    out.append("] ");
+    out.append(message);
+    for (const auto& field : fields) {
+        out.push_back(' ');
+        out.append(field.key);
+        out.push_back('=');
+        std::visit(
+            [&out](const auto& value) -> void {
+                std::format_to(std::back_inserter(out), "{}", value);
+            },
+            field.value);
+    }
+    out.push_back('\n');
+    out.append(reset_code);
+}
+
+// rapidjson 的输出流, 直接追加到调用方复用的 std::string
+struct StringOutput {
+    using Ch = char;
+
+    std::string* out = nullptr;
+
+    void Put(char c) { out->push_back(c); } // NOLINT
+
+    void Flush() {} // NOLINT
+};
+
+// 一行一个 JSON 对象:
+// {"ts":"2024-01-02T03:04:05.678901Z","level":"INFO","thread":"...","file":"...","line":1,
+//  "message":"...","fields":{...}}
+void format_json(
+    std::string& out,
+    LogLevel level,
+    std::chrono::time_point<std::chrono::system_clock> now,
+    std::string_view tid,
+    std::string_view file,
+    uint32_t line,
+    std::string_view message,
+    std::span<const logging::Field> fields) {
+    // Writer 内部的栈在 Reset 后保留容量, 每个线程一份, 稳定后不再分配
+    thread_local StringOutput stream;
+    thread_local rapidjson::Writer<StringOutput> writer;
+
+    // 秒以上的部分同一秒内复用, 只重新格式化微秒
+    struct TimeCache {
+        int64_t sec = INT64_MIN;
+        std::string text;
+        std::string ts;
+    };
+    thread_local TimeCache cache;
+
+    const auto sec = std::chrono::floor<std::chrono::seconds>(now);
+    if (sec.time_since_epoch().count() != cache.sec) {
+        cache.sec = sec.time_since_epoch().count();
+        cache.text.clear();
+        std::format_to(std::back_inserter(cache.text), "{:%FT%T}", sec);
+    }
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now - sec).count();
+    cache.ts.assign(cache.text);
+    std::format_to(std::back_inserter(cache.ts), ".{:06}Z", micros);
+
+    auto key = [](std::string_view k) -> void {
+        writer.Key(k.data(), static_cast<rapidjson::SizeType>(k.size()));
+    };
+    auto string = [](std::string_view v) -> void {
+        writer.String(v.data(), static_cast<rapidjson::SizeType>(v.size()));
+    };
+
+    stream.out = &out;
+    writer.Reset(stream);
+    writer.StartObject();
+    key("ts");
+    string(cache.ts);
+    key("level");
+    string(level_name(level));
+    key("thread");
+    string(tid);
+    key("file");
+    string(file);
+    key("line");
+    writer.Uint(line);
+    key("message");
+    string(message);
+    if (!fields.empty()) {
+        key("fields");
+        writer.StartObject();
+        for (const auto& field : fields) {
+            key(field.key);
+            std::visit(
+                [&string](const auto& value) -> void {
+                    using T = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<T, int64_t>) {
+                        writer.Int64(value);
+                    } else if constexpr (std::is_same_v<T, uint64_t>) {
+                        writer.Uint64(value);
+                    } else if constexpr (std::is_same_v<T, double>) {
+                        // NaN / Inf 不是合法 JSON, 写成字符串
+                        if (std::isfinite(value)) {
+                            writer.Double(value);
+                        } else if (std::isnan(value)) {
+                            string("NaN");
+                        } else {
+                            string(value > 0 ? "Infinity" : "-Infinity");
+                        }
+                    } else if constexpr (std::is_same_v<T, bool>) {
+                        writer.Bool(value);
+                    } else {
+                        string(value);
+                    }
+                },
+                field.value);
+        }
+        writer.EndObject();
+    }
+    writer.EndObject();
+    out.push_back('\n');
+}
+
+void format_record(
+    std::string& out,
+    LogLevel level,
+    std::chrono::time_point<std::chrono::system_clock> now,
+    std::string_view tid,
+    std::string_view file,
+    uint32_t line,
+    std::string_view message,
+    bool colored,
+    std::span<const logging::Field> fields = {}) {
+    if (logging::format() == logging::Format::JSON) {
+        format_json(out, level, now, tid, file, line, message, fields);
+    } else {
+        format_line(out, level, now, tid, file, line, message, colored, fields);
+    }
+}
+
+using Arg = std::variant<int64_t, uint64_t, float, double, bool, char, std::string_view, const void*>;
+
+// 解析 encode_arg 写入的参数, 数据不完整时返回 false
+auto decode_args(std::string_view data, uint8_t nargs, std::vector<Arg>& args) -> bool {
+    using logging::detail::ArgTag;
+
+    auto take = [&data](void* dst, size_t n) -> bool {
+        if (data.size() < n) {
+            return false;
+        }
+        std::memcpy(dst, data.data(), n);
+        data.remove_prefix(n);
+        return true;
+    };
+
+    args.clear();
+    for (uint8_t i = 0; i < nargs; ++i) {
+        char tag = 0;
+        if (!take(&tag, 1)) {
+            return false;
+        }
+
+        switch (static_cast<ArgTag>(tag)) {
+            case ArgTag::BOOL:
+            case ArgTag::CHAR: {
+                char c = 0;
+                if (!take(&c, 1)) {
+                    return false;
+                }
+                if (static_cast<ArgTag>(tag) == ArgTag::BOOL) {
+                    args.emplace_back(c != 0);
+                } else {
+                    args.emplace_back(c);
+                }
+                break;
+            }
+            case ArgTag::F32: {
+                float f = 0;
+                if (!take(&f, sizeof(f))) {
+                    return false;
+                }
+                args.emplace_back(f);
+                break;
+            }
+            case ArgTag::STR: {
+                uint32_t len = 0;
+                if (!take(&len, sizeof(len)) || data.size() < len) {
+                    return false;
+                }
+                args.emplace_back(data.substr(0, len));
+                data.remove_prefix(len);
+                break;
+            }
+            case ArgTag::I64:
+            case ArgTag::U64:
+            case ArgTag::F64:
+            case ArgTag::PTR: {
+                uint64_t bits = 0;
+                if (!take(&bits, sizeof(bits))) {
+                    return false;
+                }
+                if (static_cast<ArgTag>(tag) == ArgTag::I64) {
+                    args.emplace_back(static_cast<int64_t>(bits));
+                } else if (static_cast<ArgTag>(tag) == ArgTag::U64) {
+                    args.emplace_back(bits);
+                } else if (static_cast<ArgTag>(tag) == ArgTag::F64) {
+                    double d = 0;
+                    std::memcpy(&d, &bits, sizeof(d));
+                    args.emplace_back(d);
+                } else {
+                    args.emplace_back(reinterpret_cast<const void*>(bits)); // NOLINT
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// 逐个替换字段调用 std::vformat_to, 支持 {} / {N} / {:spec} / {N:spec}. 嵌套的动态宽度
+// 不支持, log() 在编译期发现这种格式串后不走延迟格式化 (见 detail::has_dynamic_spec)
+void format_args(std::string& out, std::string_view fmt, const std::vector<Arg>& args) {
+    size_t next_arg = 0;
+    std::string spec;
+
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        const char c = fmt[i];
+        if (c == '}' && i + 1 < fmt.size() && fmt[i + 1] == '}') {
+            out.push_back('}');
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            out.push_back(c);
+            continue;
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+            out.push_back('{');
+            ++i;
+            continue;
+        }
+
+        const size_t close = fmt.find('}', i);
+        if (close == std::string_view::npos) {
+            out.append(fmt.substr(i));
+            return;
+        }
+
+        std::string_view field = fmt.substr(i + 1, close - i - 1);
+        std::string_view id = field.substr(0, field.find(':'));
+        size_t index = next_arg++;
+        if (!id.empty()) {
+            index = 0;
+            for (char d : id) {
+                index = (index * 10) + static_cast<size_t>(d - '0');
+            }
+        }
+
+        spec.assign("{");
+        spec.append(field.substr(id.size()));
+        spec.append("}");
+
+        try {
+            if (index >= args.size()) {
+                throw std::format_error("argument index out of range");
+            }
+            std::visit(
+                [&](const auto& value) -> void {
+                    std::vformat_to(std::back_inserter(out), spec, std::make_format_args(value));
+                },
+                args[index]);
+        } catch (const std::format_error&) {
+            out.append(fmt.substr(i, close - i + 1));
+        }
+        i = close;
+    }
+}
+
+void render_binary(
+    std::string& out,
+    const logging::detail::BinaryHeader& header,
+    std::string_view payload,
+    std::string_view tid,
+    std::string_view fmt,
+    std::string_view file,
+    std::vector<Arg>& args,
+    std::string& message,
+    bool colored) {
+    message.clear();
+    if (decode_args(payload, header.nargs, args)) {
+        format_args(message, fmt, args);
+    } else {
+        message.append("<corrupted record> ");
+        message.append(fmt);
+    }
+
+    const std::chrono::system_clock::time_point now{
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(header.timestamp))};
+    format_record(out, header.level, now, tid, file, header.line, message, colored);
+}
+
+// binary_path 文件由若干帧组成: [u8 type][u64 id][u32 len][bytes]
+enum class Frame : uint8_t {
+    THREAD = 1, // id 为 ring 序号, bytes 为线程 id
+    STRING = 2, // id 为格式串 / 文件名的地址, bytes 为其内容
+    RECORD = 3, // id 为 ring 序号, bytes 为 ring 中的原始记录
+};
+
+constexpr size_t kFrameHeader = 1 + sizeof(uint64_t) + sizeof(uint32_t);
+
+auto frame_header(Frame type, uint64_t id, size_t size) -> std::array<char, kFrameHeader> {
+    const auto len = static_cast<uint32_t>(size);
+    std::array<char, kFrameHeader> header{};
+    header[0] = static_cast<char>(type);
+    std::memcpy(&header[1], &id, sizeof(id));
+    std::memcpy(&header[1 + sizeof(id)], &len, sizeof(len));
+    return header;
+}
+
+void append_frame(std::string& out, Frame type, uint64_t id, std::string_view bytes) {
+    const auto header = frame_header(type, id, bytes.size());
+    out.append(header.data(), header.size());
+    out.append(bytes);
+}
+
+// 信号处理函数里的输出: 固定大小的缓冲区, 满了直接 write(2), 不分配内存也不加锁.
+// 记录一律按文本格式渲染, 忽略格式说明 ({:.2f} 等同于 {}), 不输出颜色码.
+class CrashWriter {
+public:
+    void reset(int fd) {
+        fd_ = fd;
+        size_ = 0;
+    }
+
+    void flush() {
+        write_fd(fd_, {buf_.data(), size_});
+        size_ = 0;
+    }
+
+    void append(std::string_view data) {
+        while (!data.empty()) {
+            if (size_ == buf_.size()) {
+                flush();
+            }
+            const size_t n = std::min(data.size(), buf_.size() - size_);
+            std::memcpy(&buf_[size_], data.data(), n);
+            size_ += n;
+            data.remove_prefix(n);
+        }
+    }
+
+    template <typename T>
+    void number(T value, int base = 10) {
+        std::array<char, 32> tmp{};
+        std::to_chars_result res{};
+        if constexpr (std::is_floating_point_v<T>) {
+            res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), value);
+        } else {
+            res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), value, base);
+        }
+        append({tmp.data(), res.ptr});
+    }
+
+    // 定宽补零, 用于时间
+    void padded(int value, int width) {
+        for (int limit = 10; --width > 0; limit *= 10) {
+            if (value < limit) {
+                append("0");
+            }
+        }
+        number(value);
+    }
+
+    // YYYY-MM-DD HH:MM:SS (UTC), 不经过 std::format 和 locale
+    void time(int64_t timestamp_ns) {
+        using namespace std::chrono;
+        const sys_seconds sec = floor<seconds>(sys_time<nanoseconds>(nanoseconds(timestamp_ns)));
+        const auto day = floor<days>(sec);
+        const year_month_day ymd{day};
+        const hh_mm_ss hms{sec - day};
+        padded(static_cast<int>(ymd.year()), 4);
+        append("-");
+        padded(static_cast<int>(static_cast<unsigned>(ymd.month())), 2);
+        append("-");
+        padded(static_cast<int>(static_cast<unsigned>(ymd.day())), 2);
+        append(" ");
+        padded(static_cast<int>(hms.hours().count()), 2);
+        append(":");
+        padded(static_cast<int>(hms.minutes().count()), 2);
+        append(":");
+        padded(static_cast<int>(hms.seconds().count()), 2);
+    }
+
+    void arg(const Arg& value) {
+        std::visit(
+            [this](const auto& v) -> void {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::string_view>) {
+                    append(v);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    append(v ? "true" : "false");
+                } else if constexpr (std::is_same_v<T, char>) {
+                    append({&v, 1});
+                } else if constexpr (std::is_same_v<T, const void*>) {
+                    append("0x");
+                    number(reinterpret_cast<uintptr_t>(v), 16); // NOLINT
+                } else {
+                    number(v);
+                }
+            },
+            value);
+    }
+
+    // 按格式串依次替换参数. 嵌套的动态宽度 / 精度 ({:>{}}) 同样占用参数, 只是不生效
+    void message(std::string_view fmt, const std::vector<Arg>& args) {
+        size_t next_arg = 0;
+        for (size_t i = 0; i < fmt.size(); ++i) {
+            const char c = fmt[i];
+            if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c) {
+                append({&fmt[i], 1});
+                ++i;
+                continue;
+            }
+            if (c != '{') {
+                append({&fmt[i], 1});
+                continue;
+            }
+
+            size_t close = i + 1;
+            size_t nested = 0;
+            for (int depth = 1; close < fmt.size(); ++close) {
+                if (fmt[close] == '{') {
+                    ++depth;
+                    nested += close + 1 < fmt.size() && fmt[close + 1] == '}' ? 1 : 0;
+                } else if (fmt[close] == '}' && --depth == 0) {
+                    break;
+                }
+            }
+            if (close == fmt.size()) {
+                append(fmt.substr(i));
+                return;
+            }
+
+            const std::string_view field = fmt.substr(i + 1, close - i - 1);
+            const std::string_view id = field.substr(0, field.find(':'));
+            size_t index = next_arg++;
+            if (!id.empty()) {
+                std::from_chars(id.data(), id.data() + id.size(), index);
+            }
+            next_arg += nested;
+            if (index < args.size()) {
+                arg(args[index]);
+            } else {
+                append(fmt.substr(i, close - i + 1));
+            }
+            i = close;
+        }
+    }
+
+private:
+    std::array<char, 16U << 10> buf_{};
+    size_t size_ = 0;
+    int fd_ = STDERR_FILENO;
+};
+
+class AsyncBackend {
+public:
+    // 故意泄漏: 其他静态对象析构时仍可能打日志
+    static auto instance() -> AsyncBackend& {
+        static auto* backend = new AsyncBackend();
+        return *backend;
+    }
+
+    AsyncBackend(const AsyncBackend&) = delete;
+    AsyncBackend(AsyncBackend&&) = delete;
+    auto operator=(const AsyncBackend&) -> AsyncBackend& = delete;
+    auto operator=(AsyncBackend&&) -> AsyncBackend& = delete;
+
+    ~AsyncBackend() = default;
+
+    void start(const logging::AsyncOptions& opts) {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        if (running_.load()) {
+            return;
+        }
+        opts_ = opts;
+        if (!opts_.binary_path.empty()) {
+            binary_fd_ = ::open(opts_.binary_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            known_ids_.clear();
+        }
+        if (opts_.flush_on_crash) {
+            install_crash_handler();
+        }
+        register_exit();
+        stopping_ = false;
+        running_.store(true, std::memory_order_release);
+        logging::detail::deferred_active.store(opts_.deferred, std::memory_order_release);
+        writer_ = std::thread([this] -> void { loop(); });
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        if (!running_.load()) {
+            return;
+        }
+        // 先切回同步模式, 后续日志不再进入 ring
+        logging::detail::deferred_active.store(false, std::memory_order_release);
+        running_.store(false);
+        // 已经通过 running_ 检查的生产者可能还没 commit, 等它们写完再做最后一次 drain.
+        // 后台线程这时还在跑, BLOCK 模式下等 ring 腾出空间的生产者也能走完
+        while (writers_.load() != 0) {
+            wake_.notify_one();
+            std::this_thread::yield();
+        }
+        {
+            std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+        drain();
+        if (binary_fd_ >= 0) {
+            ::close(binary_fd_);
+            binary_fd_ = -1;
+        }
+    }
+
+    [[nodiscard]] auto running() const -> bool { return running_.load(std::memory_order_acquire); }
+
+    // 返回 false 表示记录过大或后台已停止, 调用方需要自己同步写出;
+    // 返回 true 且 dst 为空表示按 Overflow::DROP 丢弃
+    // 成功拿到 dst 之后必须调用 commit()
+    auto reserve(size_t size, char*& dst) -> bool {
+        // 先登记再检查 running_, 和 stop() 先清 running_ 再等 writers_ 归零配对 (都是 seq_cst):
+        // 要么这里看到已经停止, 要么 stop() 等到这条记录 commit 之后才做最后一次 drain
+        writers_.fetch_add(1);
+        if (!running_.load()) {
+            writers_.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+
+        RingBuffer* ring = local_ring();
+        if (size + sizeof(uint64_t) > ring->capacity() / 2) {
+            writers_.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+
+        dst = ring->reserve(static_cast<uint32_t>(size));
+        if (dst != nullptr) {
+            return true;
+        }
+
+        if (opts_.overflow == logging::Overflow::DROP) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            writers_.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        while ((dst = ring->reserve(static_cast<uint32_t>(size))) == nullptr) {
+            if (!running()) {
+                writers_.fetch_sub(1, std::memory_order_release);
+                return false;
+            }
+            wake_.notify_one();
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    void commit() {
+        RingBuffer* ring = local_ring();
+        ring->commit();
+        writers_.fetch_sub(1, std::memory_order_release);
+        if (ring->used() > ring->capacity() / 2) {
+            wake_.notify_one();
+        }
+    }
+
+    auto push(std::string_view text) -> bool {
+        char* dst = nullptr;
+        if (!reserve(1 + text.size(), dst)) {
+            return false;
+        }
+        if (dst != nullptr) {
+            *dst = static_cast<char>(logging::detail::kTextRecord);
+            std::memcpy(dst + 1, text.data(), text.size());
+            commit();
+        }
+        return true;
+    }
+
+    // 把所有 ring 中的记录写出, 后台线程 / flush() / 信号处理共用
+    void drain() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        drain_locked();
+    }
+
+    [[nodiscard]] auto dropped() const -> uint64_t {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    // 信号处理函数里调用, 必须 async-signal-safe: 只 try_lock, 任何一把锁被占用 (可能正是
+    // 出错的线程持有) 就放弃, 不分配内存, 直接 write(2). 否则 malloc 内部的 abort 或持锁时
+    // 的 SIGSEGV 会让进程卡死而不是留下 core
+    void crash_drain() {
+        if (!drain_mutex_.try_lock()) {
+            return;
+        }
+        if (rings_mutex_.try_lock()) {
+            bool sink_locked = false;
+            int fd = binary_fd_;
+            if (fd < 0) {
+                fd = STDERR_FILENO;
+                sink_locked = sink_mutex_.try_lock();
+                if (sink_locked && sink_) {
+                    const int sink_fd = sink_->crash_fd();
+                    fd = sink_fd >= 0 ? sink_fd : fd;
+                }
+            }
+
+            crash_out_.reset(fd);
+            for (const auto& ring : rings_) {
+                ring->consume([this, &ring](std::string_view record) -> void {
+                    crash_record(*ring, record);
+                });
+            }
+            crash_out_.flush();
+
+            if (sink_locked) {
+                sink_mutex_.unlock();
+            }
+            rings_mutex_.unlock();
+        }
+        drain_mutex_.unlock();
+    }
+
+    void set_sink(std::shared_ptr<logging::Sink> sink) {
+        register_exit();
+        std::shared_ptr<logging::Sink> old;
+        {
+            std::lock_guard<std::mutex> lock(sink_mutex_);
+            colored_.store(sink ? sink->colored() : true, std::memory_order_relaxed);
+            old = std::exchange(sink_, std::move(sink));
+            if (old) {
+                old->flush();
+            }
+        }
+    }
+
+    void flush_sink() {
+        std::lock_guard<std::mutex> lock(sink_mutex_);
+        if (sink_) {
+            sink_->flush();
+        }
+    }
+
+    // 同步路径, 与后台线程共用 sink_mutex_ 串行化
+    void write_sync(std::string_view line) {
+        std::lock_guard<std::mutex> lock(sink_mutex_);
+        if (sink_) {
+            sink_->write(line);
+        } else {
+            std::clog.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+    }
+
+    [[nodiscard]] auto colored() const -> bool { return colored_.load(std::memory_order_relaxed); }
+
+private:
+    AsyncBackend() {
+        out_.reserve(kBatchBytes * 2);
+        // 崩溃时解码参数不能再分配
+        args_.reserve(UINT8_MAX);
+    }
+
+    static constexpr size_t kBatchBytes = 64 * 1024;
+
+    struct LocalRing {
+        std::shared_ptr<RingBuffer> ring;
+
+        LocalRing() = default;
+        LocalRing(const LocalRing&) = delete;
+        LocalRing(LocalRing&&) = delete;
+        auto operator=(const LocalRing&) -> LocalRing& = delete;
+        auto operator=(LocalRing&&) -> LocalRing& = delete;
+
+        ~LocalRing() {
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    auto local_ring() -> RingBuffer* {
+        thread_local LocalRing local;
+        if (!local.ring) {
+            local.ring = std::make_shared<RingBuffer>(opts_.buffer_size);
+            local.ring->tid = thread_id_str();
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            local.ring->id = ++ring_seq_;
+            rings_.push_back(local.ring);
+        }
+        return local.ring.get();
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (!stopping_) {
+            wake_.wait_for(lock, opts_.flush_interval);
+            lock.unlock();
+            // 流量停下的限流调用点也要把丢弃条数报出来
+            logging::detail::report_suppressed(false);
+            drain();
+            lock.lock();
+        }
+    }
+
+    void write_out() {
+        if (binary_fd_ >= 0) {
+            write_fd(binary_fd_, out_);
+        } else {
+            std::lock_guard<std::mutex> lock(sink_mutex_);
+            write_sink_locked(out_);
+        }
+        out_.clear();
+    }
+
+    void write_sink_locked(std::string_view data) {
+        if (sink_) {
+            sink_->write(data);
+        } else {
+            write_fd(STDERR_FILENO, data);
+        }
+    }
+
+    static void register_exit() {
+        static std::once_flag once;
+        std::call_once(once, [] -> void {
+            std::atexit([] -> void {
+                logging::detail::report_suppressed(true);
+                instance().stop();
+                instance().flush_sink();
+            });
+        });
+    }
+
+    // 二进制落盘: 格式串 / 文件名 / 线程第一次出现时先写一帧字典
+    void dump_record(const RingBuffer& ring, std::string_view record) {
+        if (known_ids_.insert(ring.id).second) {
+            append_frame(out_, Frame::THREAD, ring.id, ring.tid);
+        }
+
+        if (static_cast<uint8_t>(record[0]) == logging::detail::kBinaryRecord) {
+            logging::detail::BinaryHeader header{};
+            std::memcpy(&header, record.data(), sizeof(header));
+            const auto fmt_id = reinterpret_cast<uint64_t>(header.fmt); // NOLINT
+            const auto file_id = reinterpret_cast<uint64_t>(header.file); // NOLINT
+            if (known_ids_.insert(fmt_id).second) {
+                append_frame(out_, Frame::STRING, fmt_id, {header.fmt, header.fmt_len});
+            }
+            if (known_ids_.insert(file_id).second) {
+                append_frame(out_, Frame::STRING, file_id, header.file);
+            }
+        }
+        append_frame(out_, Frame::RECORD, ring.id, record);
+    }
+
+    void render_record(const RingBuffer& ring, std::string_view record) {
+        if (static_cast<uint8_t>(record[0]) == logging::detail::kTextRecord) {
+            out_.append(record.substr(1));
+            return;
+        }
+
+        logging::detail::BinaryHeader header{};
+        std::memcpy(&header, record.data(), sizeof(header));
+        render_binary(
+            out_,
+            header,
+            record.substr(sizeof(header)),
+            ring.tid,
+            {header.fmt, header.fmt_len},
+            header.file,
+            args_,
+            message_,
+            colored());
+    }
+
+    // 崩溃路径的 dump_record / render_record: 二进制落盘时每条记录都带上自己的字典帧,
+    // 不查也不改 known_ids_
+    void crash_record(const RingBuffer& ring, std::string_view record) {
+        const bool binary = static_cast<uint8_t>(record[0]) == logging::detail::kBinaryRecord;
+        logging::detail::BinaryHeader header{};
+        if (binary) {
+            std::memcpy(&header, record.data(), sizeof(header));
+        }
+
+        if (binary_fd_ >= 0) {
+            auto frame = [this](Frame type, uint64_t id, std::string_view bytes) -> void {
+                const auto head = frame_header(type, id, bytes.size());
+                crash_out_.append({head.data(), head.size()});
+                crash_out_.append(bytes);
+            };
+            frame(Frame::THREAD, ring.id, ring.tid);
+            if (binary) {
+                const auto fmt_id = reinterpret_cast<uint64_t>(header.fmt); // NOLINT
+                const auto file_id = reinterpret_cast<uint64_t>(header.file); // NOLINT
+                frame(Frame::STRING, fmt_id, {header.fmt, header.fmt_len});
+                frame(Frame::STRING, file_id, header.file);
+            }
+            frame(Frame::RECORD, ring.id, record);
+            return;
+        }
+
+        if (!binary) {
+            crash_out_.append(record.substr(1));
+            return;
+        }
+        crash_out_.append("[");
+        crash_out_.time(header.timestamp);
+        crash_out_.append("] [");
+        crash_out_.append(ring.tid);
+        crash_out_.append("] [");
+        crash_out_.append(level_name(header.level));
+        crash_out_.append("] [");
+        crash_out_.append(header.file);
+        crash_out_.append(":");
+        crash_out_.number(header.line);
+        crash_out_.append("] ");
+        if (decode_args(record.substr(sizeof(header)), header.nargs, args_)) {
+            crash_out_.message({header.fmt, header.fmt_len}, args_);
+        } else {
+            crash_out_.append("<corrupted record> ");
+            crash_out_.append({header.fmt, header.fmt_len});
+        }
+        crash_out_.append("\n");
+    }
+
+    void drain_locked() {
+        std::vector<std::shared_ptr<RingBuffer>> rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings = rings_;
+        }
+
+        for (const auto& ring : rings) {
+            ring->consume([this, &ring](std::string_view record) -> void {
+                if (binary_fd_ >= 0) {
+                    dump_record(*ring, record);
+                } else {
+                    render_record(*ring, record);
+                }
+                if (out_.size() >= kBatchBytes) {
+                    write_out();
+                }
+            });
+        }
+        if (!out_.empty()) {
+            write_out();
+        }
+
+        // 线程已退出且已读空的 ring 可以回收
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        std::erase_if(rings_, [](const std::shared_ptr<RingBuffer>& ring) -> bool {
+            return ring->closed.load(std::memory_order_acquire) && ring->empty();
+        });
+    }
+
+    static void on_crash(int sig) {
+        instance().crash_drain();
+        // 换回安装之前的处理 (默认处理, 或者 absl / gtest 之类装的 handler) 再重新触发.
+        // 信号在本函数返回前被屏蔽, 返回后由原来的处理接手, 默认处理时照常留下 core dump
+        sigaction(sig, &previous_handlers_[static_cast<size_t>(sig)], nullptr); // NOLINT
+        ::raise(sig);
+    }
+
+    static void install_crash_handler() {
+        static std::once_flag once;
+        std::call_once(once, [] -> void {
+            for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+                struct sigaction sa {};
+                sa.sa_handler = &AsyncBackend::on_crash;
+                sigemptyset(&sa.sa_mask);
+                sa.sa_flags = SA_RESETHAND;
+                sigaction(sig, &sa, &previous_handlers_.at(static_cast<size_t>(sig)));
+            }
+        });
+    }
+
+    // install_crash_handler 之前各信号的处理, 崩溃时还给它们
+    static inline std::array<struct sigaction, NSIG> previous_handlers_{};
+
+    logging::AsyncOptions opts_;
+    std::atomic<bool> running_{false};
+    // reserve 到 commit 之间的生产者数
+    std::atomic<uint32_t> writers_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex state_mutex_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<RingBuffer>> rings_;
+    uint64_t ring_seq_ = 0;
+
+    // 以下只在持有 drain_mutex_ 时访问
+    std::mutex drain_mutex_;
+    std::string out_;
+    std::string message_;
+    std::vector<Arg> args_;
+    int binary_fd_ = -1;
+    std::unordered_set<uint64_t> known_ids_;
+    CrashWriter crash_out_;
+
+    std::mutex sink_mutex_;
+    std::shared_ptr<logging::Sink> sink_;
+    std::atomic<bool> colored_{true};
+};
+
+} // namespace
+
+namespace logging {
+
+void start_async(const AsyncOptions& opts) {
+    AsyncBackend::instance().start(opts);
+}
+
+void stop_async() {
+    AsyncBackend::instance().stop();
+}
+
+void flush() {
+    logging::detail::report_suppressed(true);
+    auto& backend = AsyncBackend::instance();
+    if (backend.running()) {
+        backend.drain();
+    }
+    backend.flush_sink();
+}
+
+void set_sink(std::shared_ptr<Sink> sink) {
+    AsyncBackend::instance().set_sink(std::move(sink));
+}
+
+auto async_enabled() -> bool {
+    return AsyncBackend::instance().running();
+}
+
+auto dropped() -> uint64_t {
+    return AsyncBackend::instance().dropped();
+}
+
+auto decode(std::string_view data) -> std::string {
+    std::string out;
+    std::string message;
+    std::vector<Arg> args;
+    std::unordered_map<uint64_t, std::string_view> dict;
+
+    while (data.size() >= kFrameHeader) {
+        const auto type = static_cast<Frame>(data[0]);
+        uint64_t id = 0;
+        uint32_t len = 0;
+        std::memcpy(&id, data.data() + 1, sizeof(id));
+        std::memcpy(&len, data.data() + 1 + sizeof(id), sizeof(len));
+        data.remove_prefix(kFrameHeader);
+        if (data.size() < len) {
+            break;
+        }
+        std::string_view bytes = data.substr(0, len);
+        data.remove_prefix(len);
+
+        if (type == Frame::THREAD || type == Frame::STRING) {
+            dict[id] = bytes;
+            continue;
+        }
+        if (type != Frame::RECORD || bytes.empty()) {
+            continue;
+        }
+
+        if (static_cast<uint8_t>(bytes[0]) == detail::kTextRecord) {
+            out.append(bytes.substr(1));
+            continue;
+        }
+        if (bytes.size() < sizeof(detail::BinaryHeader)) {
+            continue;
+        }
+
+        detail::BinaryHeader header{};
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        render_binary(
+            out,
+            header,
+            bytes.substr(sizeof(header)),
+            dict[id],
+            dict[reinterpret_cast<uint64_t>(header.fmt)], // NOLINT
+            dict[reinterpret_cast<uint64_t>(header.file)], // NOLINT
+            args,
+            message,
+            true);
+    }
+    return out;
+}
+
+namespace detail {
+
+auto reserve(size_t size, char*& dst) -> bool {
+    return AsyncBackend::instance().reserve(size, dst);
+}
+
+void commit() {
+    AsyncBackend::instance().commit();
+}
+
+} // namespace detail
+
+} // namespace logging
+
+void log_impl(
+    LogLevel level,
+    std::chrono::time_point<std::chrono::system_clock> now,
+    const std::source_location& loc,
+    std::string_view message,
+    std::span<const logging::Field> fields) {
+    thread_local const std::string tid = thread_id_str();
+    // 每个线程复用同一块缓冲, 稳定后不再分配
+    thread_local std::string final_log;
+    final_log.clear();
+    auto& backend = AsyncBackend::instance();
+    format_record(
+        final_log,
+        level,
+        now,
+        tid,
+        loc.file_name(),
+        loc.line(),
+        message,
+        backend.colored(),
+        fields);
+
+    if (backend.running() && backend.push(final_log)) {
+        return;
+    }
+    backend.write_sync(final_log);
+}
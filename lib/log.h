@@ -1,15 +1,25 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <concepts>
 #include <cstdint>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <source_location>
+#include <span>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <variant>
 
 enum class LogLevel : uint8_t {
     TRACE,
@@ -19,76 +29,615 @@ enum class LogLevel : uint8_t {
     ERROR,
 };
 
-inline void log_impl(
+// 编译期最低等级, 低于它的宏不生成任何代码, 例如 --copt=-DLOG_MIN_LEVEL=2 只保留 INFO 及以上
+#ifndef LOG_MIN_LEVEL
+    #define LOG_MIN_LEVEL 0
+#endif
+
+namespace logging {
+
+// 每条记录的输出格式
+enum class Format : uint8_t {
+    TEXT, // [时间] [线程] [等级] [文件:行号] 消息 key=value...
+    JSON, // 一行一个 JSON 对象, 方便直接导入索引系统
+};
+
+namespace detail {
+inline std::atomic<LogLevel> runtime_level{LogLevel::TRACE};
+inline std::atomic<Format> output_format{Format::TEXT};
+} // namespace detail
+
+// 运行期最低等级, 宏在求值任何参数之前检查
+inline void set_level(LogLevel level) {
+    detail::runtime_level.store(level, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline auto level() -> LogLevel {
+    return detail::runtime_level.load(std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline auto enabled(LogLevel level) -> bool {
+    return level >= detail::runtime_level.load(std::memory_order_relaxed);
+}
+
+inline void set_format(Format format) {
+    detail::output_format.store(format, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline auto format() -> Format {
+    return detail::output_format.load(std::memory_order_relaxed);
+}
+
+// 附加在一条记录上的带类型键值对. 字符串只保存视图, 只在 LOG_KV 所在的表达式内有效.
+struct Field {
+    using Value = std::variant<int64_t, uint64_t, double, bool, std::string_view>;
+
+    std::string_view key;
+    Value value;
+};
+
+template <typename T>
+auto field_value(const T& value) -> Field::Value {
+    if constexpr (std::is_same_v<T, bool>) {
+        return value;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        return static_cast<int64_t>(value);
+    } else if constexpr (std::is_integral_v<T>) {
+        return static_cast<uint64_t>(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<double>(value);
+    } else {
+        return std::string_view(value);
+    }
+}
+
+// fields("user", uid, "cost_ms", 1.5) 按 key, value 交替传入
+template <typename... KV>
+auto fields(const KV&... kv) -> std::array<Field, sizeof...(KV) / 2> {
+    static_assert(sizeof...(KV) % 2 == 0, "fields() expects key, value pairs");
+    const auto args = std::forward_as_tuple(kv...);
+    return [&args]<size_t... I>(std::index_sequence<I...>) -> std::array<Field, sizeof...(I)> {
+        return {Field{
+            .key = std::string_view(std::get<2 * I>(args)),
+            .value = field_value(std::get<2 * I + 1>(args)),
+        }...};
+    }(std::make_index_sequence<sizeof...(KV) / 2>{});
+}
+
+// 异步模式下每个线程的 ring 写满时的处理方式
+enum class Overflow : uint8_t {
+    DROP, // 丢弃并计数, 调用方永不阻塞
+    BLOCK, // 自旋等待后台线程腾出空间
+};
+
+struct AsyncOptions {
+    // 每个线程 ring 的字节数, 向上取整到 2 的幂
+    size_t buffer_size = 1U << 20;
+    Overflow overflow = Overflow::DROP;
+    // 后台线程最长的刷盘间隔
+    std::chrono::milliseconds flush_interval{50};
+    // 在 SIGSEGV/SIGABRT 等信号里尽力把 ring 中的日志写出
+    bool flush_on_crash = true;
+    // 延迟格式化: 调用线程只拷贝格式串地址, 源码位置和参数的原始字节,
+    // std::format 推迟到后台线程. 参数类型不支持时自动退回同步格式化.
+    bool deferred = false;
+    // 非空时后台线程不做格式化, 直接把二进制记录追加到该文件, 之后用 log_decode 还原
+    std::string binary_path;
+};
+
+// 日志输出目标. 同步路径和后台线程的写入由后端串行化, 实现无需自己加锁.
+struct Sink {
+    Sink() = default;
+    Sink(const Sink&) = delete;
+    Sink(Sink&&) = delete;
+    auto operator=(const Sink&) -> Sink& = delete;
+    auto operator=(Sink&&) -> Sink& = delete;
+    virtual ~Sink() = default;
+
+    virtual void write(std::string_view data) = 0;
+
+    virtual void flush() {}
+
+    // 崩溃时在信号处理函数里调用, 只能做 write(2) 这类 async-signal-safe 的操作: 写出已缓冲
+    // 的数据并返回之后可以直接写入的 fd. 返回 -1 表示做不到, 崩溃时的日志改写到 stderr
+    virtual auto crash_fd() -> int { return -1; }
+
+    // 是否输出终端颜色码
+    [[nodiscard]] virtual auto colored() const -> bool { return false; }
+};
+
+// 替换输出目标, 传 nullptr 恢复为 stderr. 旧 sink 会先 flush.
+void set_sink(std::shared_ptr<Sink> sink);
+
+// 开启异步模式: 调用线程只把格式化好的记录写入自己的无锁 ring,
+// 由后台线程批量写 stderr. 重复调用无副作用.
+void start_async(const AsyncOptions& opts = {});
+
+// 写出所有积压的日志并停止后台线程, 之后回到同步模式.
+void stop_async();
+
+// 同步等待当前所有线程 ring 中的日志写出, 并 flush sink.
+// 限流调用点还没报告的丢弃条数也在这时输出.
+void flush();
+
+[[nodiscard]] auto async_enabled() -> bool;
+
+// 因 Overflow::DROP 丢弃的记录数
+[[nodiscard]] auto dropped() -> uint64_t;
+
+// 把 AsyncOptions::binary_path 写出的内容还原成文本日志
+[[nodiscard]] auto decode(std::string_view data) -> std::string;
+
+namespace detail {
+
+enum class ArgTag : uint8_t {
+    NONE,
+    I64,
+    U64,
+    F32,
+    F64,
+    BOOL,
+    CHAR,
+    STR,
+    PTR,
+};
+
+template <typename T>
+consteval auto arg_tag() -> ArgTag {
+    if constexpr (std::is_same_v<T, bool>) {
+        return ArgTag::BOOL;
+    } else if constexpr (std::is_same_v<T, char>) {
+        return ArgTag::CHAR;
+    } else if constexpr (
+        std::is_same_v<T, wchar_t> || std::is_same_v<T, char8_t> || std::is_same_v<T, char16_t>
+        || std::is_same_v<T, char32_t>) {
+        return ArgTag::NONE;
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int64_t)) {
+        return std::is_signed_v<T> ? ArgTag::I64 : ArgTag::U64;
+    } else if constexpr (std::is_same_v<T, float>) {
+        return ArgTag::F32;
+    } else if constexpr (std::is_same_v<T, double>) {
+        return ArgTag::F64;
+    } else if constexpr (
+        std::is_same_v<T, std::nullptr_t> || std::is_same_v<T, void*>
+        || std::is_same_v<T, const void*>) {
+        return ArgTag::PTR;
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        return ArgTag::STR;
+    } else {
+        return ArgTag::NONE;
+    }
+}
+
+// 可以按原始字节拷贝, 由后台线程格式化的参数类型
+template <typename T>
+concept Encodable = arg_tag<std::remove_cvref_t<T>>() != ArgTag::NONE;
+
+// 延迟格式化记录的固定头部, 后面紧跟 nargs 个 [tag][payload]
+struct BinaryHeader {
+    uint8_t kind;
+    LogLevel level;
+    uint8_t nargs;
+    uint32_t line;
+    int64_t timestamp; // system_clock, 纳秒
+    const char* fmt;
+    const char* file;
+    uint32_t fmt_len;
+};
+
+inline constexpr uint8_t kTextRecord = 0;
+inline constexpr uint8_t kBinaryRecord = 1;
+
+// 异步 + 延迟格式化同时开启时为 true, 调用点只需一次 relaxed load
+inline std::atomic<bool> deferred_active{false};
+
+// 在当前线程的 ring 中预留 size 字节. 返回 false 表示记录过大, 调用方改走文本路径;
+// 返回 true 且 dst 为空表示按 Overflow::DROP 丢弃.
+auto reserve(size_t size, char*& dst) -> bool;
+
+void commit();
+
+template <typename T>
+auto arg_size(const T& value) -> size_t {
+    constexpr ArgTag tag = arg_tag<std::remove_cvref_t<T>>();
+    if constexpr (tag == ArgTag::STR) {
+        return 1 + sizeof(uint32_t) + std::string_view(value).size();
+    } else if constexpr (tag == ArgTag::BOOL || tag == ArgTag::CHAR) {
+        return 1 + 1;
+    } else if constexpr (tag == ArgTag::F32) {
+        return 1 + sizeof(float);
+    } else {
+        return 1 + sizeof(uint64_t);
+    }
+}
+
+template <typename T>
+auto encode_arg(char* dst, const T& value) -> char* {
+    constexpr ArgTag tag = arg_tag<std::remove_cvref_t<T>>();
+    *dst++ = static_cast<char>(tag);
+
+    if constexpr (tag == ArgTag::STR) {
+        std::string_view sv(value);
+        auto len = static_cast<uint32_t>(sv.size());
+        std::memcpy(dst, &len, sizeof(len));
+        std::memcpy(dst + sizeof(len), sv.data(), sv.size());
+        return dst + sizeof(len) + sv.size();
+    } else if constexpr (tag == ArgTag::BOOL || tag == ArgTag::CHAR) {
+        *dst = static_cast<char>(value);
+        return dst + 1;
+    } else if constexpr (tag == ArgTag::F32) {
+        std::memcpy(dst, &value, sizeof(float));
+        return dst + sizeof(float);
+    } else {
+        uint64_t bits = 0;
+        if constexpr (tag == ArgTag::F64) {
+            std::memcpy(&bits, &value, sizeof(bits));
+        } else if constexpr (tag == ArgTag::PTR) {
+            bits = reinterpret_cast<uintptr_t>(static_cast<const void*>(value)); // NOLINT
+        } else {
+            bits = static_cast<uint64_t>(value);
+        }
+        std::memcpy(dst, &bits, sizeof(bits));
+        return dst + sizeof(bits);
+    }
+}
+
+// 线程内复用的消息缓冲. 格式化参数时如果又打了日志 (formatter 里调用 INFO 等),
+// 内层退回到临时 string, 避免覆盖外层正在写的内容.
+class MessageBuffer {
+public:
+    MessageBuffer() : buf_(acquire()) {}
+
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer(MessageBuffer&&) = delete;
+    auto operator=(const MessageBuffer&) -> MessageBuffer& = delete;
+    auto operator=(MessageBuffer&&) -> MessageBuffer& = delete;
+
+    ~MessageBuffer() {
+        if (buf_ != &local_) {
+            slot().busy = false;
+        }
+    }
+
+    auto get() -> std::string& { return *buf_; }
+
+private:
+    struct Slot {
+        std::string buf;
+        bool busy = false;
+    };
+
+    static auto slot() -> Slot& {
+        thread_local Slot s;
+        return s;
+    }
+
+    auto acquire() -> std::string* {
+        Slot& s = slot();
+        if (s.busy) {
+            return &local_;
+        }
+        s.busy = true;
+        s.buf.clear();
+        return &s.buf;
+    }
+
+    std::string local_;
+    std::string* buf_;
+};
+
+// 调用点级别的限流状态, 由 LOG_EVERY_N / LOG_PER_SECOND / LOG_SAMPLED 在宏展开处定义为函数内
+// static.
+// 构造函数是 constexpr, 静态初始化无需 guard; 判断只用 relaxed 原子操作, 不加锁.
+// 被丢弃的条数每个调用点每秒最多报告一次: 放行时顺带报告, 流量停了之后由 report_suppressed
+// 补报 (异步模式的后台线程定期调用, flush() 和进程退出时全部报出).
+class SiteLimiter {
+public:
+    constexpr SiteLimiter(LogLevel level, const std::source_location& loc)
+        : level_(level), loc_(loc) {}
+
+    SiteLimiter(const SiteLimiter&) = delete;
+    SiteLimiter(SiteLimiter&&) = delete;
+    auto operator=(const SiteLimiter&) -> SiteLimiter& = delete;
+    auto operator=(SiteLimiter&&) -> SiteLimiter& = delete;
+    ~SiteLimiter() = default;
+
+    // 每 every 条放行 1 条. 放行时 suppressed 为需要报告的丢弃条数, 通常为 0
+    auto sample(uint32_t every, uint64_t& suppressed) -> bool {
+        if (every > 1 && counter_.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+            suppress();
+            return false;
+        }
+        suppressed = take(now_seconds(), false);
+        return true;
+    }
+
+    // 以概率 p 放行. 随机数来自线程内的 xorshift64, 和阈值比较, 不碰共享状态
+    auto chance(double p, uint64_t& suppressed) -> bool {
+        // 0x1p64 * p 在 p < 1 时不会溢出 uint64_t
+        if (p < 1.0 && (p <= 0.0 || next_random() >= static_cast<uint64_t>(0x1p64 * p))) {
+            suppress();
+            return false;
+        }
+        suppressed = take(now_seconds(), false);
+        return true;
+    }
+
+    // 每秒最多放行 per_second 条. 高 32 位是秒, 低 32 位是该秒内已放行的条数, 一次 CAS 更新
+    auto rate(uint32_t per_second, uint64_t& suppressed) -> bool {
+        const uint32_t now = now_seconds();
+        uint64_t cur = window_.load(std::memory_order_relaxed);
+        while (true) {
+            const auto second = static_cast<uint32_t>(cur >> 32U);
+            const auto count = static_cast<uint32_t>(cur);
+            uint64_t next = (static_cast<uint64_t>(now) << 32U) | 1U;
+            if (second == now) {
+                if (count >= per_second) {
+                    suppress();
+                    return false;
+                }
+                next = cur + 1;
+            }
+            if (window_.compare_exchange_weak(cur, next, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        suppressed = take(now, false);
+        return true;
+    }
+
+    // 取走待报告的丢弃条数. force 为 false 时同一秒内最多取到一次
+    auto take(uint32_t now, bool force) -> uint64_t {
+        if (suppressed_.load(std::memory_order_relaxed) == 0) {
+            return 0;
+        }
+        if (!force) {
+            uint32_t last = last_report_.load(std::memory_order_relaxed);
+            if (last == now
+                || !last_report_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+                return 0;
+            }
+        }
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto level() const -> LogLevel { return level_; }
+
+    [[nodiscard]] auto location() const -> const std::source_location& { return loc_; }
+
+    [[nodiscard]] auto next() const -> SiteLimiter* { return next_; }
+
+    // 丢弃过记录的调用点组成的无锁链表, 只增不删 (限流状态都是 static)
+    [[nodiscard]] static auto first() -> SiteLimiter* {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    static auto now_seconds() -> uint32_t {
+        return static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+private:
+    // 种子取线程局部变量的地址和当前时间, 保证非零且各线程不同
+    static auto next_random() -> uint64_t {
+        thread_local uint64_t state
+            = (reinterpret_cast<uintptr_t>(&state) // NOLINT
+               ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()))
+              | 1U;
+        state ^= state << 13U;
+        state ^= state >> 7U;
+        state ^= state << 17U;
+        return state;
+    }
+
+    void suppress() {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        if (!registered_.load(std::memory_order_relaxed)
+            && !registered_.exchange(true, std::memory_order_relaxed)) {
+            next_ = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(
+                next_, this, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    static inline std::atomic<SiteLimiter*> head_{nullptr};
+
+    const LogLevel level_;
+    const std::source_location loc_;
+    std::atomic<uint64_t> counter_{0};
+    std::atomic<uint64_t> window_{0};
+    std::atomic<uint64_t> suppressed_{0};
+    std::atomic<uint32_t> last_report_{0};
+    std::atomic<bool> registered_{false};
+    SiteLimiter* next_ = nullptr;
+};
+
+// 格式说明里嵌套了替换字段 (动态宽度 / 精度, 例如 {:>{}}) 时返回 true.
+// 后台线程的渲染不支持这种写法, 这样的调用点总在调用线程格式化
+consteval auto has_dynamic_spec(std::string_view fmt) -> bool {
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] != '{') {
+            continue;
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+            ++i;
+            continue;
+        }
+        for (++i; i < fmt.size() && fmt[i] != '}'; ++i) {
+            if (fmt[i] == '{') {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// std::format_string 加上编译期检查的结果, 调用点不需要额外的运行时开销
+template <typename... Args>
+struct FormatString {
+    template <typename T>
+        requires std::convertible_to<const T&, std::string_view>
+    consteval FormatString(const T& s) // NOLINT(google-explicit-constructor)
+        : format(s), dynamic_spec(has_dynamic_spec(s)) {}
+
+    std::format_string<Args...> format;
+    bool dynamic_spec;
+};
+
+template <typename... Args>
+auto log_deferred(
+    LogLevel level, const std::source_location& loc, std::string_view fmt, const Args&... args)
+    -> bool {
+    const size_t size = sizeof(BinaryHeader) + (arg_size(args) + ... + 0);
+    char* dst = nullptr;
+    if (!reserve(size, dst)) {
+        return false;
+    }
+    if (dst == nullptr) {
+        return true;
+    }
+
+    BinaryHeader header{
+        .kind = kBinaryRecord,
+        .level = level,
+        .nargs = static_cast<uint8_t>(sizeof...(Args)),
+        .line = loc.line(),
+        .timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count(),
+        .fmt = fmt.data(),
+        .file = loc.file_name(),
+        .fmt_len = static_cast<uint32_t>(fmt.size()),
+    };
+    std::memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    ((dst = encode_arg(dst, args)), ...);
+    commit();
+    return true;
+}
+
+} // namespace detail
+
+} // namespace logging
+
+void log_impl(
     LogLevel level,
     std::chrono::time_point<std::chrono::system_clock> now,
     const std::source_location& loc,
-    std::string_view message) {
-    // 简单的颜色代码
-    const char* color_code = "";
-    const char* level_str = "";
-
-    switch (level) {
-        case LogLevel::TRACE:
-            level_str = "TRACE";
-            color_code = "\033[32m";
-            break;
-        case LogLevel::DEBUG:
-            level_str = "DEBUG";
-            color_code = "\033[32m";
-            break;
-        case LogLevel::INFO:
-            level_str = "INFO";
-            color_code = "\033[32m";
-            break;
-        case LogLevel::WARN:
-            level_str = "WARN";
-            color_code = "\033[33m";
-            break;
-        case LogLevel::ERROR:
-            level_str = "ERROR";
-            color_code = "\033[31m";
-            break;
-    }
-    const char* reset_code = "\033[0m";
-
-    // 格式化最终日志条目
-    // C++20 chrono 也可以直接被 format
-    // {:%F %T} 是 YYYY-MM-DD HH:MM:SS 格式
-
-    thread_local auto tid = std::this_thread::get_id();
-    std::ostringstream oss;
-    oss << tid;
-
-    std::string final_log = std::format(
-        "[{:%F %T}] [{}] [{}] [{}:{}] {}\n",
-        std::chrono::floor<std::chrono::seconds>(now), // 时间
-        oss.str(),
-        level_str, // 等级文本
-        loc.file_name(), // 文件名
-        loc.line(), // 行号
-        message // 用户格式化好的消息
-    );
-    std::clog << color_code << final_log << reset_code;
-}
+    std::string_view message,
+    std::span<const logging::Field> fields = {});
 
 template <typename... Args>
 void log(
     LogLevel level,
     const std::source_location& loc,
-    std::format_string<Args...> fmt,
+    logging::detail::FormatString<std::type_identity_t<Args>...> fmt,
     Args&&... args) {
-    std::string user_msg = std::format(fmt, std::forward<Args>(args)...);
+    if constexpr (sizeof...(Args) <= UINT8_MAX && (logging::detail::Encodable<Args> && ...)) {
+        if (!fmt.dynamic_spec && logging::detail::deferred_active.load(std::memory_order_relaxed)
+            && logging::detail::log_deferred(level, loc, fmt.format.get(), args...)) {
+            return;
+        }
+    }
+    logging::detail::MessageBuffer buffer;
+    std::string& user_msg = buffer.get();
+    std::format_to(std::back_inserter(user_msg), fmt.format, std::forward<Args>(args)...);
     log_impl(level, std::chrono::system_clock::now(), loc, user_msg);
 }
 
-#define TRACE(fmt, ...) \
-    log(LogLevel::TRACE, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define DEBUG(fmt, ...) \
-    log(LogLevel::DEBUG, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define INFO(fmt, ...) \
-    log(LogLevel::INFO, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define WARN(fmt, ...) \
-    log(LogLevel::WARN, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
-#define ERROR(fmt, ...) \
-    log(LogLevel::ERROR, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__)
+// 带键值对的记录总在调用线程格式化, 不走延迟格式化
+template <size_t N, typename... Args>
+void log_kv(
+    LogLevel level,
+    const std::source_location& loc,
+    const std::array<logging::Field, N>& fields,
+    std::format_string<Args...> fmt,
+    Args&&... args) {
+    logging::detail::MessageBuffer buffer;
+    std::string& user_msg = buffer.get();
+    std::format_to(std::back_inserter(user_msg), fmt, std::forward<Args>(args)...);
+    log_impl(level, std::chrono::system_clock::now(), loc, user_msg, fields);
+}
+
+namespace logging::detail {
+
+inline void log_suppressed(LogLevel level, const std::source_location& loc, uint64_t count) {
+    ::log(level, loc, "suppressed {} messages", count);
+}
+
+// 补报各限流调用点还没输出的丢弃条数. force 为 false 时每个调用点每秒最多一条
+inline void report_suppressed(bool force) {
+    const uint32_t now = SiteLimiter::now_seconds();
+    for (SiteLimiter* limiter = SiteLimiter::first(); limiter != nullptr;
+         limiter = limiter->next()) {
+        if (const uint64_t count = limiter->take(now, force); count > 0) {
+            log_suppressed(limiter->level(), limiter->location(), count);
+        }
+    }
+}
+
+} // namespace logging::detail
+
+#define LOG_AT(level, fmt, ...)                                                              \
+    do {                                                                                     \
+        if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL) {                            \
+            if (logging::enabled(level)) {                                                   \
+                log(level, std::source_location::current(), fmt __VA_OPT__(, ) __VA_ARGS__); \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+
+// LOG_KV(LogLevel::INFO, logging::fields("user", uid), "login from {}", ip)
+#define LOG_KV(level, kv, fmt, ...)                                                          \
+    do {                                                                                     \
+        if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL) {                            \
+            if (logging::enabled(level)) {                                                   \
+                log_kv(                                                                      \
+                    level,                                                                   \
+                    std::source_location::current(),                                         \
+                    kv,                                                                      \
+                    fmt __VA_OPT__(, ) __VA_ARGS__);                                         \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+
+#define TRACE(fmt, ...) LOG_AT(LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define DEBUG(fmt, ...) LOG_AT(LogLevel::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define INFO(fmt, ...)  LOG_AT(LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define WARN(fmt, ...)  LOG_AT(LogLevel::WARN, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define ERROR(fmt, ...) LOG_AT(LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+// 限流宏的公共部分, method 为 SiteLimiter 的 sample / rate
+#define LOG_LIMITED(level, method, n, fmt, ...)                                       \
+    do {                                                                              \
+        if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL) {                     \
+            if (logging::enabled(level)) {                                            \
+                static logging::detail::SiteLimiter log_limiter{                      \
+                    level, std::source_location::current()};                          \
+                uint64_t log_dropped = 0;                                             \
+                if (log_limiter.method(n, log_dropped)) {                             \
+                    const auto& log_loc = log_limiter.location();                     \
+                    if (log_dropped > 0) {                                            \
+                        logging::detail::log_suppressed(level, log_loc, log_dropped); \
+                    }                                                                 \
+                    log(level, log_loc, fmt __VA_OPT__(, ) __VA_ARGS__);              \
+                }                                                                     \
+            }                                                                         \
+        }                                                                             \
+    } while (0)
+
+// 同一调用点每 n 条只输出 1 条, 例如 LOG_EVERY_N(LogLevel::WARN, 100, "retry {}", id)
+#define LOG_EVERY_N(level, n, fmt, ...) \
+    LOG_LIMITED(level, sample, n, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+// 同一调用点每秒最多输出 n 条, 超出的只计数, 每秒最多一条 "suppressed N messages"
+#define LOG_PER_SECOND(level, n, fmt, ...) \
+    LOG_LIMITED(level, rate, n, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+// 同一调用点每条以概率 p (0 到 1) 输出, 例如 LOG_SAMPLED(LogLevel::INFO, 0.01, "hit {}", key).
+// 和 LOG_EVERY_N 不同, 不会和请求的周期性对齐
+#define LOG_SAMPLED(level, p, fmt, ...) \
+    LOG_LIMITED(level, chance, p, fmt __VA_OPT__(, ) __VA_ARGS__)
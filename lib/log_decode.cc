@@ -0,0 +1,24 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "lib/log.h"
+
+// 把 AsyncOptions::binary_path 写出的二进制日志还原成文本
+auto main(int argc, char** argv) -> int {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <binary log file>\n"; // NOLINT
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary); // NOLINT
+    if (!in) {
+        std::cerr << "open " << argv[1] << " failed\n"; // NOLINT
+        return 1;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::cout << logging::decode(data);
+    return 0;
+}
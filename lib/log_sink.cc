@@ -0,0 +1,267 @@
+#include "lib/log_sink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/compressor.h"
+
+namespace logging {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+// 分片按块压缩, 每块是一个独立的 ZSTD 帧. 后台线程最多占用一块输入和一块输出的内存,
+// 和分片大小无关. 多个帧首尾相连仍是合法的 .zst, zstd -d 和 Compressor 都能直接解开
+constexpr size_t kCompressChunk = 4U << 20;
+
+void compress_file(const Compressor& compressor, const fs::path& src, const fs::path& dst) {
+    std::ifstream in(src, std::ios::binary);
+    std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+    std::string chunk;
+    while (in) {
+        chunk.resize(kCompressChunk);
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        chunk.resize(static_cast<size_t>(in.gcount()));
+        if (chunk.empty()) {
+            break;
+        }
+        const std::string compressed = compressor.compress(chunk);
+        out.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+    }
+    if (!out) {
+        throw std::runtime_error("write " + dst.string() + " failed");
+    }
+}
+
+} // namespace
+
+RotatingFileSink::RotatingFileSink(RotateOptions opts) : opts_(std::move(opts)) {
+    if (opts_.path.empty()) {
+        throw std::invalid_argument("RotatingFileSink: empty path");
+    }
+    buffer_.reserve(opts_.buffer_size);
+    if (!open()) {
+        throw std::system_error(errno, std::generic_category(), "open " + opts_.path);
+    }
+    compressor_ = std::thread([this] -> void { compress_loop(); });
+}
+
+RotatingFileSink::~RotatingFileSink() {
+    write_buffer();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (compressor_.joinable()) {
+        compressor_.join();
+    }
+}
+
+auto RotatingFileSink::open() -> bool {
+    fs::path path(opts_.path);
+    if (path.has_parent_path()) {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+    }
+
+    fd_ = ::open(opts_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    written_ = ec ? 0 : static_cast<size_t>(size);
+    opened_at_ = std::chrono::system_clock::now();
+    return true;
+}
+
+void RotatingFileSink::write(std::string_view data) {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    if (fd_ < 0) {
+        return;
+    }
+    if (buffer_.size() + data.size() > opts_.buffer_size) {
+        write_buffer();
+    }
+
+    if (data.size() >= opts_.buffer_size) {
+        write_all(fd_, data);
+        written_ += data.size();
+    } else {
+        buffer_.append(data);
+    }
+
+    const size_t total = written_ + buffer_.size();
+    const bool too_big = opts_.max_bytes > 0 && total >= opts_.max_bytes;
+    const bool too_old = opts_.max_age.count() > 0
+                         && std::chrono::system_clock::now() - opened_at_ >= opts_.max_age;
+    if (too_big || too_old) {
+        rotate_locked();
+    }
+}
+
+void RotatingFileSink::flush() {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    write_buffer();
+}
+
+// 信号处理函数里调用, 只 try_lock: 锁可能正被出错的线程持有, 这时让后端改写 stderr.
+// clear() 只改长度, 不释放内存
+auto RotatingFileSink::crash_fd() -> int {
+    if (!io_mutex_.try_lock()) {
+        return -1;
+    }
+    if (fd_ >= 0 && !buffer_.empty()) {
+        write_all(fd_, buffer_);
+        buffer_.clear();
+    }
+    const int fd = fd_;
+    io_mutex_.unlock();
+    return fd;
+}
+
+void RotatingFileSink::write_buffer() {
+    if (buffer_.empty() || fd_ < 0) {
+        return;
+    }
+    write_all(fd_, buffer_);
+    written_ += buffer_.size();
+    buffer_.clear();
+}
+
+void RotatingFileSink::rotate() {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    rotate_locked();
+}
+
+void RotatingFileSink::rotate_locked() {
+    write_buffer();
+    if (written_ == 0) {
+        return;
+    }
+    ::close(fd_);
+    fd_ = -1;
+
+    const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+    std::string archive = std::format("{}.{:%Y%m%d-%H%M%S}.{:04}", opts_.path, now, seq_++);
+
+    std::error_code ec;
+    fs::rename(opts_.path, archive, ec);
+    if (!open()) {
+        // 重新打开失败时丢弃后续写入, 不能让写日志的线程抛异常
+        std::cerr << "reopen " << opts_.path << " failed: " << std::strerror(errno) << '\n';
+    }
+
+    if (ec) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(archive));
+    }
+    cv_.notify_all();
+}
+
+void RotatingFileSink::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] -> bool { return pending_.empty() && !busy_; });
+}
+
+void RotatingFileSink::compress_loop() {
+    auto compressor = Compressor::create(Compressor::Type::ZSTD);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] -> bool { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+
+        std::string archive = std::move(pending_.front());
+        pending_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        if (opts_.compress) {
+            try {
+                const std::string tmp = archive + ".zst.tmp";
+                compress_file(*compressor, archive, tmp);
+                std::error_code ec;
+                fs::rename(tmp, archive + ".zst", ec);
+                if (!ec) {
+                    fs::remove(archive, ec);
+                }
+            } catch (const std::exception& ex) {
+                // 不能走日志, 否则会递归写回本 sink
+                std::cerr << "compress " << archive << " failed: " << ex.what() << '\n';
+            }
+        }
+        prune();
+
+        lock.lock();
+        busy_ = false;
+        cv_.notify_all();
+    }
+}
+
+// 按文件名 (含时间戳) 排序, 只保留最新的 max_files 个历史文件
+void RotatingFileSink::prune() {
+    if (opts_.max_files == 0) {
+        return;
+    }
+
+    const fs::path path(opts_.path);
+    const fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    const std::string prefix = path.filename().string() + ".";
+
+    std::vector<fs::path> archives;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.starts_with(prefix) && !name.ends_with(".tmp")) {
+            archives.push_back(entry.path());
+        }
+    }
+    if (archives.size() <= opts_.max_files) {
+        return;
+    }
+
+    std::ranges::sort(archives);
+    for (size_t i = 0; i + opts_.max_files < archives.size(); ++i) {
+        fs::remove(archives[i], ec);
+    }
+}
+
+} // namespace logging
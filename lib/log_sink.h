@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "lib/log.h"
+
+namespace logging {
+
+struct RotateOptions {
+    // 当前写入的文件, 滚动后改名为 <path>.<YYYYmmdd-HHMMSS>.<seq>, 压缩后再加 .zst
+    std::string path;
+    // 单个文件的大小上限, 0 表示不按大小滚动
+    size_t max_bytes = 256U << 20;
+    // 单个文件的最长写入时间, 0 表示不按时间滚动
+    std::chrono::seconds max_age{0};
+    // 攒够这么多字节才落一次盘
+    size_t buffer_size = 1U << 20;
+    // 保留的历史文件数量, 0 表示不清理
+    size_t max_files = 10;
+    // 滚动出的文件在后台线程用 Compressor (ZSTD) 按 4 MiB 分块压缩, 内存占用和 max_bytes 无关
+    bool compress = true;
+};
+
+// 按大小 / 时间滚动的文件 sink. 写入方只做内存拷贝和大块 write,
+// 压缩和清理历史文件都在独立线程完成, 不会阻塞打日志的线程.
+class RotatingFileSink final : public Sink {
+public:
+    explicit RotatingFileSink(RotateOptions opts);
+
+    RotatingFileSink(const RotatingFileSink&) = delete;
+    RotatingFileSink(RotatingFileSink&&) = delete;
+    auto operator=(const RotatingFileSink&) -> RotatingFileSink& = delete;
+    auto operator=(RotatingFileSink&&) -> RotatingFileSink& = delete;
+
+    ~RotatingFileSink() override;
+
+    void write(std::string_view data) override;
+
+    void flush() override;
+
+    auto crash_fd() -> int override;
+
+    // 立即滚动当前文件. 可以和后台线程的 write 并发调用
+    void rotate();
+
+    // 等待已滚动的文件全部压缩完成
+    void wait_idle();
+
+private:
+    auto open() -> bool;
+    void rotate_locked();
+    void write_buffer();
+    void compress_loop();
+    void prune();
+
+    RotateOptions opts_;
+
+    // 保护 fd_ / written_ / opened_at_ / buffer_: 后端写入时持有自己的锁, 但 rotate 和 flush
+    // 也可能由用户线程直接调用
+    std::mutex io_mutex_;
+    int fd_ = -1;
+    size_t written_ = 0;
+    uint32_t seq_ = 0;
+    std::chrono::system_clock::time_point opened_at_;
+    std::string buffer_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> pending_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::thread compressor_;
+};
+
+} // namespace logging
@@ -1,27 +1,399 @@
 #include "lib/meta.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <format>
+#include <future>
+#include <latch>
+#include <map>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <sys/resource.h>
+
+#ifdef __GLIBC__
+    #include <gnu/libc-version.h>
+#endif
 
 #include "cpuinfo.h"
 
+namespace {
+
+auto cache_info(uint32_t count, const struct cpuinfo_cache* cache) -> CacheInfo {
+    CacheInfo info;
+    info.count = count;
+    if (count > 0 && cache != nullptr) {
+        info.size = cache->size;
+        info.associativity = cache->associativity;
+        info.line_size = cache->line_size;
+        info.shared = cache->processor_count;
+    }
+    return info;
+}
+
+} // namespace
+
 CpuInfo::CpuInfo()
     : processors(cpuinfo_get_processors_count()),
       cores(cpuinfo_get_cores_count()),
       socket(cpuinfo_get_packages_count()),
-      l1(cpuinfo_get_l1d_caches_count()),
-      l2(cpuinfo_get_l2_caches_count()),
-      l3(cpuinfo_get_l3_caches_count()),
-      l4(cpuinfo_get_l4_caches_count()) {
+      l1i(cache_info(cpuinfo_get_l1i_caches_count(), cpuinfo_get_l1i_caches())),
+      l1(cache_info(cpuinfo_get_l1d_caches_count(), cpuinfo_get_l1d_caches())),
+      l2(cache_info(cpuinfo_get_l2_caches_count(), cpuinfo_get_l2_caches())),
+      l3(cache_info(cpuinfo_get_l3_caches_count(), cpuinfo_get_l3_caches())),
+      l4(cache_info(cpuinfo_get_l4_caches_count(), cpuinfo_get_l4_caches())) {
     name = std::string(cpuinfo_get_package(0)->name); // NOLINT
 
+    isa.sse42 = cpuinfo_has_x86_sse4_2();
+    isa.avx2 = cpuinfo_has_x86_avx2();
+    isa.fma = cpuinfo_has_x86_fma3();
+    isa.bmi2 = cpuinfo_has_x86_bmi2();
+    isa.adx = cpuinfo_has_x86_adx();
+    isa.avx512f = cpuinfo_has_x86_avx512f();
+    isa.avx512bw = cpuinfo_has_x86_avx512bw();
+    isa.avx512vl = cpuinfo_has_x86_avx512vl();
+    isa.neon = cpuinfo_has_arm_neon();
+
     for (uint32_t i = 0; i < cpuinfo_get_cores_count(); ++i) {
         const struct cpuinfo_core* core = cpuinfo_get_core(i);
         frequency.push_back(core->frequency);
     }
 }
 
+auto CpuInfo::get() -> const CpuInfo& {
+    static const CpuInfo info = [] -> CpuInfo {
+        cpuinfo_initialize();
+        return {};
+    }();
+    return info;
+}
+
+namespace tuning {
+
+namespace {
+
+constexpr size_t kDefaultL1 = 32U << 10;
+constexpr size_t kDefaultL2 = 256U << 10;
+constexpr size_t kDefaultL3 = 8U << 20;
+
+auto size_or(const CacheInfo& cache, size_t fallback) -> size_t {
+    return cache.size > 0 ? cache.size : fallback;
+}
+
+// 向下取整到 2 的幂后限制在 [lo, hi]
+auto fit(size_t value, size_t lo, size_t hi) -> size_t {
+    return std::clamp(std::bit_floor(std::max<size_t>(value, 1)), lo, hi);
+}
+
+} // namespace
+
+auto compress_chunk_size() -> size_t {
+    const auto& cpu = CpuInfo::get();
+    const size_t l2 = size_or(cpu.l2, kDefaultL2) / std::max<size_t>(cpu.l2.shared, 1);
+    const size_t l3 = size_or(cpu.l3, kDefaultL3) / std::max<size_t>(cpu.l3.shared, 1);
+    return fit(std::max(l2, l3) / 2, 64U << 10, 8U << 20);
+}
+
+auto hash_batch_size(size_t item_bytes) -> size_t {
+    const size_t l1 = size_or(CpuInfo::get().l1, kDefaultL1);
+    return fit(l1 / 2 / std::max<size_t>(item_bytes, 1), 8, 4096);
+}
+
+auto arena_block_size() -> size_t {
+    return fit(size_or(CpuInfo::get().l2, kDefaultL2) / 2, 4U << 10, 1U << 20);
+}
+
+} // namespace tuning
+
+CpuTopology::CpuTopology() {
+    if (!cpuinfo_initialize()) {
+        return;
+    }
+
+    const uint32_t l2_count = cpuinfo_get_l2_caches_count();
+    const uint32_t l3_count = cpuinfo_get_l3_caches_count();
+    const struct cpuinfo_cache* l2_base = cpuinfo_get_l2_caches();
+    const struct cpuinfo_cache* l3_base = cpuinfo_get_l3_caches();
+
+    processors_.reserve(cpuinfo_get_processors_count());
+    for (uint32_t i = 0; i < cpuinfo_get_processors_count(); ++i) {
+        const struct cpuinfo_processor* p = cpuinfo_get_processor(i);
+        Processor proc;
+#ifdef __linux__
+        proc.cpu = static_cast<uint32_t>(p->linux_id);
+#else
+        proc.cpu = i;
+#endif
+        proc.smt_id = p->smt_id;
+        proc.core = static_cast<uint32_t>(p->core - cpuinfo_get_cores());
+        proc.cluster = static_cast<uint32_t>(p->cluster - cpuinfo_get_clusters());
+        proc.package = static_cast<uint32_t>(p->package - cpuinfo_get_packages());
+        // 没有该级缓存时退化为更粗的粒度, 编号放在真实缓存之后避免冲突
+        proc.l2 = p->cache.l2 != nullptr ? static_cast<uint32_t>(p->cache.l2 - l2_base)
+                                         : l2_count + proc.core;
+        proc.l3 = p->cache.l3 != nullptr ? static_cast<uint32_t>(p->cache.l3 - l3_base)
+                                         : l3_count + proc.package;
+        processors_.push_back(proc);
+    }
+}
+
+auto CpuTopology::get() -> const CpuTopology& {
+    static const CpuTopology topology;
+    return topology;
+}
+
+auto CpuTopology::group_by(uint32_t Processor::* key) const -> std::vector<CpuSet> {
+    std::map<uint32_t, CpuSet> groups;
+    for (const auto& p : processors_) {
+        groups[p.*key].push_back(p.cpu);
+    }
+
+    std::vector<CpuSet> result;
+    result.reserve(groups.size());
+    for (auto& [id, cpus] : groups) { // NOLINT
+        std::ranges::sort(cpus);
+        result.push_back(std::move(cpus));
+    }
+    return result;
+}
+
+auto CpuTopology::smt_siblings(uint32_t cpu) const -> CpuSet {
+    auto it = std::ranges::find(processors_, cpu, &Processor::cpu);
+    if (it == processors_.end()) {
+        return {};
+    }
+
+    CpuSet siblings;
+    for (const auto& p : processors_) {
+        if (p.core == it->core) {
+            siblings.push_back(p.cpu);
+        }
+    }
+    std::ranges::sort(siblings);
+    return siblings;
+}
+
+auto CpuTopology::plan(size_t n, Placement placement) const -> std::vector<CpuSet> {
+    if (processors_.empty() || n == 0) {
+        return {};
+    }
+
+    // 只在允许运行的 CPU 里分配, 否则容器的 cpuset 限制下绑定会失败
+    const CpuSet allowed = allowed_cpus();
+    std::vector<Processor> ordered;
+    ordered.reserve(processors_.size());
+    for (const auto& p : processors_) {
+        if (allowed.empty() || std::ranges::binary_search(allowed, p.cpu)) {
+            ordered.push_back(p);
+        }
+    }
+    if (ordered.empty()) {
+        return {};
+    }
+
+    // 按 (L3, 核, SMT) 排序后每个核取第一个逻辑 CPU, 相邻的线程落在同一块 L3 上
+    std::ranges::sort(ordered, [](const Processor& a, const Processor& b) -> bool {
+        return std::tie(a.l3, a.core, a.smt_id) < std::tie(b.l3, b.core, b.smt_id);
+    });
+
+    std::vector<const Processor*> primaries;
+    for (const auto& p : ordered) {
+        if (primaries.empty() || primaries.back()->core != p.core) {
+            primaries.push_back(&p);
+        }
+    }
+
+    std::map<uint32_t, CpuSet> l3;
+    if (placement == Placement::L3) {
+        for (const auto& p : ordered) {
+            l3[p.l3].push_back(p.cpu);
+        }
+    }
+
+    std::vector<CpuSet> result;
+    result.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Processor* p = primaries[i % primaries.size()];
+        if (placement == Placement::CORE) {
+            result.push_back({p->cpu});
+        } else {
+            result.push_back(l3[p->l3]);
+        }
+    }
+    return result;
+}
+
+namespace {
+
+#ifdef __linux__
+auto to_cpu_set(const CpuSet& cpus) -> cpu_set_t {
+    cpu_set_t set;
+    CPU_ZERO(&set); // NOLINT
+    for (uint32_t cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set); // NOLINT
+        }
+    }
+    return set;
+}
+#endif
+
+} // namespace
+
+auto allowed_cpus() -> CpuSet {
+    CpuSet cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set); // NOLINT
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return cpus;
+    }
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) { // NOLINT
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+auto pin_current_thread(const CpuSet& cpus) -> bool {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    const cpu_set_t set = to_cpu_set(cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+auto pin_thread(std::thread& thread, const CpuSet& cpus) -> bool {
+#ifdef __linux__
+    if (cpus.empty() || !thread.joinable()) {
+        return false;
+    }
+    const cpu_set_t set = to_cpu_set(cpus);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+auto pin_workers(
+    size_t n,
+    const std::vector<CpuSet>& plan,
+    const std::function<void(std::function<void()>)>& submit) -> bool {
+    if (n == 0 || plan.empty()) {
+        return false;
+    }
+
+    // 任务可能在 pin_workers 返回之后才真正退出, 共享状态由任务一起持有
+    struct State {
+        explicit State(size_t n)
+            : running(static_cast<std::ptrdiff_t>(n)), done(static_cast<std::ptrdiff_t>(n)) {}
+
+        std::atomic<size_t> next{0};
+        std::atomic<bool> ok{true};
+        std::latch running;
+        std::latch done;
+        std::vector<CpuSet> plan;
+    };
+    auto state = std::make_shared<State>(n);
+    state->plan = plan;
+
+    for (size_t i = 0; i < n; ++i) {
+        submit([state] -> void {
+            const size_t idx = state->next.fetch_add(1, std::memory_order_relaxed);
+            if (!pin_current_thread(state->plan[idx % state->plan.size()])) {
+                state->ok.store(false, std::memory_order_relaxed);
+            }
+            state->running.arrive_and_wait();
+            state->done.count_down();
+        });
+    }
+    state->done.wait();
+    return state->ok.load(std::memory_order_relaxed);
+}
+
+namespace {
+
+// /proc 下的文件 stat 出来大小为 0, 只能读到 EOF
+auto read_file(const char* path) -> std::string {
+    std::string content;
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return content;
+    }
+
+    std::array<char, 4096> buf{};
+    while (true) {
+        const ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        content.append(buf.data(), static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return content;
+}
+
+auto trim(std::string_view s) -> std::string_view {
+    const auto begin = s.find_first_not_of(" \t\n");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const auto end = s.find_last_not_of(" \t\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+// 按行遍历 "key: value" 格式的内容, 如 /proc/meminfo 和 /proc/cpuinfo
+template <typename F>
+void for_each_field(std::string_view content, F&& fn) {
+    while (!content.empty()) {
+        const auto eol = content.find('\n');
+        const std::string_view line = content.substr(0, eol);
+        content.remove_prefix(eol == std::string_view::npos ? content.size() : eol + 1);
+
+        const auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        if (!fn(trim(line.substr(0, colon)), trim(line.substr(colon + 1)))) {
+            return;
+        }
+    }
+}
+
+// "16318164 kB" -> MB
+auto kb_to_mb(std::string_view value) -> uint64_t {
+    uint64_t kb = 0;
+    std::from_chars(value.data(), value.data() + value.size(), kb);
+    return kb / 1024;
+}
+
+} // namespace
+
 [[nodiscard]] EnvInfo::EnvInfo() : pid(getpid()) {
     struct utsname name {};
 
@@ -30,14 +402,77 @@ CpuInfo::CpuInfo()
         release = static_cast<const char*>(name.release);
         version = static_cast<const char*>(name.version);
         machine = static_cast<const char*>(name.machine);
+        hostname = static_cast<const char*>(name.nodename);
+    }
+
+#ifdef __GLIBC__
+    libc = std::format("glibc {}", gnu_get_libc_version());
+#endif
+#ifdef __VERSION__
+    compiler = __VERSION__;
+#endif
+
+    std::error_code ec;
+    const auto& space_info = std::filesystem::space("/", ec);
+    if (!ec) {
+        disk_info.capacity = space_info.capacity / 1024 / 1024;
+        disk_info.free = space_info.free / 1024 / 1024;
+        disk_info.available = space_info.available / 1024 / 1024;
     }
 
-    std::filesystem::path p = "/";
-    const auto& space_info = std::filesystem::space(p);
+#ifdef __linux__
+    kernel = std::string(trim(read_file("/proc/version")));
+
+    auto on_meminfo = [this](std::string_view key, std::string_view value) -> bool {
+        if (key == "MemTotal") {
+            mem_info.total = kb_to_mb(value);
+        } else if (key == "MemAvailable") {
+            mem_info.available = kb_to_mb(value);
+        } else if (key == "SwapTotal") {
+            mem_info.swap_total = kb_to_mb(value);
+        } else if (key == "SwapFree") {
+            mem_info.swap_free = kb_to_mb(value);
+        }
+        return true;
+    };
+    for_each_field(read_file("/proc/meminfo"), on_meminfo);
 
-    disk_info.capacity = space_info.capacity / 1024 / 1024;
-    disk_info.free = space_info.free / 1024 / 1024;
-    disk_info.available = space_info.available / 1024 / 1024;
+    // 所有处理器的 model name 相同, 读到第一个即可
+    auto on_cpuinfo = [this](std::string_view key, std::string_view value) -> bool {
+        if (key == "model name" || key == "Model") {
+            cpu_model = std::string(value);
+            return false;
+        }
+        return true;
+    };
+    for_each_field(read_file("/proc/cpuinfo"), on_cpuinfo);
+
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        const std::string node = entry.path().filename().string();
+        if (node.starts_with("node") && node.size() > 4
+            && std::isdigit(static_cast<unsigned char>(node[4])) != 0) {
+            ++numa_nodes;
+        }
+    }
+#endif
+}
+
+namespace {
+
+auto env_snapshot() -> const std::shared_future<EnvInfo>& {
+    static const std::shared_future<EnvInfo> snapshot =
+        std::async(std::launch::async, [] -> EnvInfo { return {}; }).share();
+    return snapshot;
+}
+
+} // namespace
+
+void EnvInfo::prefetch() {
+    (void)env_snapshot();
+}
+
+auto EnvInfo::get() -> const EnvInfo& {
+    return env_snapshot().get();
 }
 
 auto EnvInfo::toStr() const -> std::string {
@@ -48,6 +483,18 @@ auto EnvInfo::toStr() const -> std::string {
     kvs["version"] = version;
     kvs["machine"] = machine;
 
+    kvs["hostname"] = hostname;
+    kvs["kernel"] = kernel;
+    kvs["libc"] = libc;
+    kvs["compiler"] = compiler;
+    kvs["cpu.model"] = cpu_model;
+    kvs["numa.nodes"] = std::to_string(numa_nodes);
+
+    kvs["mem.total"] = std::format("{} MB", mem_info.total);
+    kvs["mem.available"] = std::format("{} MB", mem_info.available);
+    kvs["swap.total"] = std::format("{} MB", mem_info.swap_total);
+    kvs["swap.free"] = std::format("{} MB", mem_info.swap_free);
+
     kvs["disk.capacity"] = std::format("{} MB", disk_info.capacity);
     kvs["disk.free"] = std::format("{} MB", disk_info.free);
     kvs["disk.available"] = std::format("{} MB", disk_info.available);
@@ -65,3 +512,274 @@ auto EnvInfo::toStr() const -> std::string {
 
     return oss.str();
 }
+
+namespace {
+
+// 读入调用方提供的缓冲, 采样路径上不分配内存
+auto read_into(const char* path, std::span<char> buf) -> std::string_view {
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return {};
+    }
+
+    size_t len = 0;
+    while (len < buf.size()) {
+        const ssize_t n = ::read(fd, buf.data() + len, buf.size() - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    return {buf.data(), len};
+}
+
+auto parse_u64(std::string_view s) -> uint64_t {
+    uint64_t value = 0;
+    std::from_chars(s.data(), s.data() + s.size(), value);
+    return value;
+}
+
+// 第 index 个以空格分隔的字段
+auto nth_field(std::string_view s, size_t index) -> std::string_view {
+    for (size_t i = 0; i < index; ++i) {
+        const auto space = s.find(' ');
+        if (space == std::string_view::npos) {
+            return {};
+        }
+        s.remove_prefix(space + 1);
+    }
+    return s.substr(0, s.find(' '));
+}
+
+auto count_fds() -> uint32_t {
+    DIR* dir = ::opendir("/proc/self/fd");
+    if (dir == nullptr) {
+        return 0;
+    }
+    uint32_t n = 0;
+    while (const struct dirent* entry = ::readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            ++n;
+        }
+    }
+    ::closedir(dir);
+    // 不计 opendir 自己打开的 fd
+    return n > 0 ? n - 1 : 0;
+}
+
+void collect_threads(std::vector<ResourceSample::ThreadCpu>& out, size_t max_threads) {
+    out.clear();
+    DIR* dir = ::opendir("/proc/self/task");
+    if (dir == nullptr) {
+        return;
+    }
+
+    static const auto ticks = static_cast<uint64_t>(std::max(sysconf(_SC_CLK_TCK), 1L));
+    std::array<char, 64> path{};
+    std::array<char, 512> buf{};
+    while (const struct dirent* entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        if (out.size() >= max_threads) {
+            break;
+        }
+
+        const auto res = std::format_to_n(
+            path.data(), path.size() - 1, "/proc/self/task/{}/stat", entry->d_name);
+        *res.out = '\0';
+
+        // tid (comm) state ppid ... 第 14, 15 个字段是 utime / stime; comm 里可能有空格和括号
+        const std::string_view stat = read_into(path.data(), buf);
+        const auto lparen = stat.find('(');
+        const auto rparen = stat.rfind(')');
+        if (lparen == std::string_view::npos || rparen == std::string_view::npos
+            || rparen + 2 > stat.size()) {
+            continue;
+        }
+        const std::string_view rest = stat.substr(rparen + 2);
+
+        ResourceSample::ThreadCpu thread;
+        thread.tid = static_cast<pid_t>(parse_u64(stat.substr(0, lparen)));
+        const uint64_t cpu_ticks = parse_u64(nth_field(rest, 11)) + parse_u64(nth_field(rest, 12));
+        thread.cpu_us = cpu_ticks * 1000000 / ticks;
+        const std::string_view comm = stat.substr(lparen + 1, rparen - lparen - 1);
+        std::memcpy(thread.name.data(), comm.data(), std::min(comm.size(), thread.name.size() - 1));
+        out.push_back(thread);
+    }
+    ::closedir(dir);
+
+    std::ranges::sort(out, {}, &ResourceSample::ThreadCpu::tid);
+}
+
+void collect_sample(ResourceSample& out, bool per_thread, size_t max_threads) {
+    out.at = std::chrono::steady_clock::now();
+
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        out.minor_faults = static_cast<uint64_t>(usage.ru_minflt);
+        out.major_faults = static_cast<uint64_t>(usage.ru_majflt);
+        out.voluntary_switches = static_cast<uint64_t>(usage.ru_nvcsw);
+        out.involuntary_switches = static_cast<uint64_t>(usage.ru_nivcsw);
+        out.user_cpu_us = static_cast<uint64_t>(usage.ru_utime.tv_sec) * 1000000
+                          + static_cast<uint64_t>(usage.ru_utime.tv_usec);
+        out.system_cpu_us = static_cast<uint64_t>(usage.ru_stime.tv_sec) * 1000000
+                            + static_cast<uint64_t>(usage.ru_stime.tv_usec);
+    }
+
+#ifdef __linux__
+    // statm: size resident shared ..., 单位是页
+    std::array<char, 128> buf{};
+    static const auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    out.rss = parse_u64(nth_field(read_into("/proc/self/statm", buf), 1)) * page;
+    out.fds = count_fds();
+    if (per_thread) {
+        collect_threads(out.threads, max_threads);
+    } else {
+        out.threads.clear();
+    }
+#else
+    (void)per_thread;
+    (void)max_threads;
+#endif
+}
+
+} // namespace
+
+auto ResourceSample::now(bool per_thread) -> ResourceSample {
+    ResourceSample sample;
+    collect_sample(sample, per_thread, SIZE_MAX);
+    return sample;
+}
+
+auto ResourceSample::operator-(const ResourceSample& older) const -> ResourceSample {
+    auto diff = [](uint64_t a, uint64_t b) -> uint64_t { return a > b ? a - b : 0; };
+
+    ResourceSample d;
+    d.at = at;
+    d.rss = rss;
+    d.fds = fds;
+    d.minor_faults = diff(minor_faults, older.minor_faults);
+    d.major_faults = diff(major_faults, older.major_faults);
+    d.voluntary_switches = diff(voluntary_switches, older.voluntary_switches);
+    d.involuntary_switches = diff(involuntary_switches, older.involuntary_switches);
+    d.user_cpu_us = diff(user_cpu_us, older.user_cpu_us);
+    d.system_cpu_us = diff(system_cpu_us, older.system_cpu_us);
+
+    // 两边都按 tid 升序, 归并即可
+    auto it = older.threads.begin();
+    for (const auto& thread : threads) {
+        while (it != older.threads.end() && it->tid < thread.tid) {
+            ++it;
+        }
+        if (it != older.threads.end() && it->tid == thread.tid) {
+            ThreadCpu t = thread;
+            t.cpu_us = diff(thread.cpu_us, it->cpu_us);
+            d.threads.push_back(t);
+        }
+    }
+    return d;
+}
+
+ResourceSampler::ResourceSampler(Options opts) : opts_(opts) {
+    opts_.capacity = std::max<size_t>(opts_.capacity, 1);
+    ring_.resize(opts_.capacity);
+    if (opts_.per_thread) {
+        for (auto& slot : ring_) {
+            slot.threads.reserve(opts_.max_threads);
+        }
+        scratch_.threads.reserve(opts_.max_threads);
+    }
+}
+
+ResourceSampler::~ResourceSampler() {
+    stop();
+}
+
+void ResourceSampler::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (worker_.joinable()) {
+        return;
+    }
+    stop_ = false;
+    worker_ = std::thread([this] -> void { loop(); });
+}
+
+void ResourceSampler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void ResourceSampler::loop() {
+    while (true) {
+        collect_and_push();
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_for(lock, opts_.interval, [this] -> bool { return stop_; })) {
+            return;
+        }
+    }
+}
+
+// 先在 scratch_ 里采集, 再与 ring 中最旧的槽交换, 两边的 vector 容量都得到复用
+void ResourceSampler::collect_and_push() {
+    std::lock_guard<std::mutex> collect_lock(collect_mutex_);
+    collect_sample(scratch_, opts_.per_thread, opts_.max_threads);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(ring_[next_], scratch_);
+    next_ = (next_ + 1) % ring_.size();
+    size_ = std::min(size_ + 1, ring_.size());
+}
+
+auto ResourceSampler::sample() -> ResourceSample {
+    collect_and_push();
+    return latest();
+}
+
+auto ResourceSampler::latest() const -> ResourceSample {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_ == 0) {
+        return {};
+    }
+    return ring_[(next_ + ring_.size() - 1) % ring_.size()];
+}
+
+auto ResourceSampler::history() const -> std::vector<ResourceSample> {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ResourceSample> result;
+    result.reserve(size_);
+    for (size_t i = 0; i < size_; ++i) {
+        result.push_back(ring_[(next_ + ring_.size() - size_ + i) % ring_.size()]);
+    }
+    return result;
+}
+
+auto ResourceSampler::delta(std::chrono::steady_clock::duration window) const -> ResourceSample {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_ == 0) {
+        return {};
+    }
+
+    const size_t cap = ring_.size();
+    const ResourceSample& newest = ring_[(next_ + cap - 1) % cap];
+    const auto target = newest.at - window;
+    // 从新到旧找第一个不晚于 target 的样本, 找不到就用最旧的
+    size_t back = size_ - 1;
+    for (size_t i = 1; i < size_; ++i) {
+        if (ring_[(next_ + cap - 1 - i) % cap].at <= target) {
+            back = i;
+            break;
+        }
+    }
+    return newest - ring_[(next_ + cap - 1 - back) % cap];
+}
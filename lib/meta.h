@@ -1,13 +1,21 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <format>
+#include <functional>
+#include <initializer_list>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <unistd.h>
@@ -52,20 +60,133 @@ inline auto defer(F&& fn) -> DeferredAction<F> {
     return DeferredAction<F>(std::forward<F>(fn));
 }
 
+// 某一级缓存的几何参数, 取该级第一块缓存为代表
+struct CacheInfo {
+    uint32_t count = 0; // 这一级缓存的块数, 0 表示没有这一级
+    uint32_t size = 0; // 单块容量, 字节
+    uint32_t associativity = 0;
+    uint32_t line_size = 0;
+    uint32_t shared = 0; // 共享同一块缓存的逻辑 CPU 数
+};
+
+// 运行期检测到的指令集扩展, 非 x86 上 x86 相关的字段都为 false
+struct IsaFeatures {
+    bool sse42 = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool bmi2 = false;
+    bool adx = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+    bool neon = false;
+};
+
 struct CpuInfo {
     std::string name;
     uint16_t processors = 0;
     uint16_t cores = 0;
     uint16_t socket = 0;
 
-    uint32_t l1 = 0;
-    uint32_t l2 = 0;
-    uint32_t l3 = 0;
-    uint32_t l4 = 0;
+    CacheInfo l1i;
+    CacheInfo l1; // L1 数据缓存
+    CacheInfo l2;
+    CacheInfo l3;
+    CacheInfo l4;
+
+    IsaFeatures isa;
 
     std::vector<uint32_t> frequency;
 
     CpuInfo();
+
+    // 进程内只读取一次, 必要时调用 cpuinfo_initialize()
+    static auto get() -> const CpuInfo&;
+};
+
+// ifunc 风格的分发: candidates 按优先级从高到低排列, 每项为 {当前 CPU 是否支持, 实现},
+// 返回第一个受支持的实现, 都不支持时返回最后一项. 结果通常放进函数内 static,
+// 只在第一次调用时选择一次, 之后每次调用只是一次间接跳转:
+//
+//   static const auto kernel = select_kernel<Fn>({
+//       {CpuInfo::get().isa.avx2, sum_avx2},
+//       {true, sum_generic},
+//   });
+template <typename Fn>
+auto select_kernel(std::initializer_list<std::pair<bool, Fn>> candidates) -> Fn {
+    Fn chosen = nullptr;
+    for (const auto& [supported, fn] : candidates) {
+        chosen = fn;
+        if (supported) {
+            break;
+        }
+    }
+    return chosen;
+}
+
+// 按本机缓存大小推算的块大小, 结果都是 2 的幂. 读不到缓存信息时按 32K/256K/8M 估计.
+namespace tuning {
+
+// 并行压缩的分片大小: 单线程可用的 L2 / L3 份额的一半, 让输入和输出都留在缓存里
+auto compress_chunk_size() -> size_t;
+
+// 批量哈希每批的条数: 一批数据不超过 L1d 的一半
+auto hash_batch_size(size_t item_bytes) -> size_t;
+
+// arena 的块大小: L2 的一半, 至少一页
+auto arena_block_size() -> size_t;
+
+} // namespace tuning
+
+template <>
+struct std::formatter<CacheInfo> {
+    static constexpr auto parse(std::format_parse_context& ctx) { return ctx.begin(); }
+
+    static auto format(const CacheInfo& cache, std::format_context& ctx) {
+        if (cache.count == 0) {
+            return std::format_to(ctx.out(), "none");
+        }
+        return std::format_to(
+            ctx.out(),
+            "{} x {} KiB, {}-way, {}B line, shared by {}",
+            cache.count,
+            cache.size / 1024,
+            cache.associativity,
+            cache.line_size,
+            cache.shared);
+    }
+};
+
+template <>
+struct std::formatter<IsaFeatures> {
+    static constexpr auto parse(std::format_parse_context& ctx) { return ctx.begin(); }
+
+    static auto format(const IsaFeatures& isa, std::format_context& ctx) {
+        auto out = ctx.out();
+        const std::array<std::pair<const char*, bool>, 9> flags{{
+            {"sse4.2", isa.sse42},
+            {"avx2", isa.avx2},
+            {"fma", isa.fma},
+            {"bmi2", isa.bmi2},
+            {"adx", isa.adx},
+            {"avx512f", isa.avx512f},
+            {"avx512bw", isa.avx512bw},
+            {"avx512vl", isa.avx512vl},
+            {"neon", isa.neon},
+        }};
+        bool first = true;
+        for (const auto& [name, enabled] : flags) { // NOLINT
+            if (!enabled) {
+                continue;
+            }
+            if (!first) {
+                out = std::format_to(out, " ");
+            }
+            first = false;
+            out = std::format_to(out, "{}", name);
+        }
+        return out;
+    }
 };
 
 template <>
@@ -79,10 +200,12 @@ struct std::formatter<CpuInfo> {
         out = std::format_to(out, "\ncores:{} ", cpu.cores);
         out = std::format_to(out, "\nsocket:{} ", cpu.socket);
 
+        out = std::format_to(out, "\nl1i:{} ", cpu.l1i);
         out = std::format_to(out, "\nl1:{} ", cpu.l1);
         out = std::format_to(out, "\nl2:{} ", cpu.l2);
         out = std::format_to(out, "\nl3:{} ", cpu.l3);
         out = std::format_to(out, "\nl4:{} ", cpu.l4);
+        out = std::format_to(out, "\nisa:{} ", cpu.isa);
         out = std::format_to(out, "\nfrequency: [");
         bool first = true;
 
@@ -97,20 +220,203 @@ struct std::formatter<CpuInfo> {
     }
 };
 
+// 逻辑 CPU 编号的集合, 即 sched_setaffinity 使用的编号
+using CpuSet = std::vector<uint32_t>;
+
+// 工作线程的摆放方式
+enum class Placement : uint8_t {
+    CORE, // 每个线程独占一个物理核的第一个 SMT 线程, 相邻的线程尽量共享 L3
+    L3, // 每个线程绑定到一组共享 L3 的 CPU, 组内由内核调度
+};
+
+// cpuinfo 给出的拓扑: 物理核 / SMT 兄弟 / cluster / package / 共享缓存的域
+class CpuTopology {
+public:
+    struct Processor {
+        uint32_t cpu = 0; // 逻辑 CPU 编号
+        uint32_t smt_id = 0; // 在物理核内的序号
+        uint32_t core = 0;
+        uint32_t cluster = 0;
+        uint32_t package = 0;
+        uint32_t l2 = 0; // 共享同一块 L2 的域, 没有 L2 时每个核各自一个
+        uint32_t l3 = 0; // 共享同一块 L3 的域, 没有 L3 时按 package
+    };
+
+    // 进程内只读取一次, 必要时调用 cpuinfo_initialize()
+    static auto get() -> const CpuTopology&;
+
+    [[nodiscard]] auto processors() const -> const std::vector<Processor>& { return processors_; }
+
+    // 以下分组都按编号升序, 每组是其中的逻辑 CPU
+    [[nodiscard]] auto cores() const -> std::vector<CpuSet> { return group_by(&Processor::core); }
+
+    [[nodiscard]] auto clusters() const -> std::vector<CpuSet> {
+        return group_by(&Processor::cluster);
+    }
+
+    [[nodiscard]] auto packages() const -> std::vector<CpuSet> {
+        return group_by(&Processor::package);
+    }
+
+    [[nodiscard]] auto l2_domains() const -> std::vector<CpuSet> {
+        return group_by(&Processor::l2);
+    }
+
+    [[nodiscard]] auto l3_domains() const -> std::vector<CpuSet> {
+        return group_by(&Processor::l3);
+    }
+
+    // 与 cpu 同属一个物理核的逻辑 CPU, 包括它自己
+    [[nodiscard]] auto smt_siblings(uint32_t cpu) const -> CpuSet;
+
+    // 给 n 个工作线程各分配一组 CPU, 只用当前线程允许运行的 CPU (sched_getaffinity, 容器的
+    // cpuset 限制也体现在这里). 线程数超过可用的物理核数时从头复用, 没有可用 CPU 时返回空.
+    [[nodiscard]] auto plan(size_t n, Placement placement) const -> std::vector<CpuSet>;
+
+private:
+    CpuTopology();
+
+    [[nodiscard]] auto group_by(uint32_t Processor::* key) const -> std::vector<CpuSet>;
+
+    std::vector<Processor> processors_;
+};
+
+// 当前线程允许运行的 CPU, 升序. 非 Linux 或获取失败时为空
+auto allowed_cpus() -> CpuSet;
+
+// 把当前线程绑定到 cpus, 非 Linux 或 cpus 为空时返回 false
+auto pin_current_thread(const CpuSet& cpus) -> bool;
+
+auto pin_thread(std::thread& thread, const CpuSet& cpus) -> bool;
+
+// 把线程池的 n 个工作线程分别绑定到 plan 中的一组 CPU, n 必须等于线程池的线程数.
+// submit 负责把任务投递到线程池; 每个任务都等 n 个任务同时运行后才返回,
+// 因此 n 个任务一定落在 n 个不同的工作线程上. 函数在全部绑定完成后返回,
+// 有任何一个线程绑定失败 (或 plan 为空) 时返回 false.
+auto pin_workers(
+    size_t n,
+    const std::vector<CpuSet>& plan,
+    const std::function<void(std::function<void()>)>& submit) -> bool;
+
+// 运行环境快照, 全部直接读 uname / /proc / sysfs, 不启动子进程
 struct EnvInfo {
     std::string sysname;
     std::string release;
     std::string version;
     std::string machine;
+    std::string hostname;
     pid_t pid;
 
+    std::string kernel; // /proc/version
+    std::string libc; // glibc 版本, 代替 ldd --version
+    std::string compiler; // 编译本程序的编译器, 代替 gcc --version
+    std::string cpu_model; // /proc/cpuinfo 的 model name
+    uint32_t numa_nodes = 0;
+
     struct DiskInfo {
         uint64_t capacity = 0;
         uint64_t free = 0;
         uint64_t available = 0;
     } disk_info;
 
+    // 单位 MB, 来自 /proc/meminfo
+    struct MemInfo {
+        uint64_t total = 0;
+        uint64_t available = 0;
+        uint64_t swap_total = 0;
+        uint64_t swap_free = 0;
+    } mem_info;
+
     EnvInfo();
 
+    // 在后台线程开始采集, 与其余初始化并行. 可重复调用
+    static void prefetch();
+
+    // 进程内只采集一次, prefetch() 还没完成时等待其结果
+    static auto get() -> const EnvInfo&;
+
     [[nodiscard]] auto toStr() const -> std::string;
-};
\ No newline at end of file
+};
+
+// 某一时刻的进程资源使用, 来自 getrusage 和 /proc/self
+struct ResourceSample {
+    struct ThreadCpu {
+        pid_t tid = 0;
+        uint64_t cpu_us = 0; // 用户态 + 内核态
+        std::array<char, 16> name{}; // /proc/self/task/<tid>/comm, 最长 15 字节
+    };
+
+    std::chrono::steady_clock::time_point at;
+    uint64_t rss = 0; // 字节
+    uint64_t minor_faults = 0;
+    uint64_t major_faults = 0;
+    uint64_t voluntary_switches = 0;
+    uint64_t involuntary_switches = 0;
+    uint64_t user_cpu_us = 0;
+    uint64_t system_cpu_us = 0;
+    uint32_t fds = 0;
+    // 按 tid 升序
+    std::vector<ThreadCpu> threads;
+
+    // 采集一次. per_thread 为 false 时跳过逐线程的 CPU 时间
+    static auto now(bool per_thread = true) -> ResourceSample;
+
+    // 计数类字段相减, rss / fds 等瞬时值取较新的一方. threads 只保留两边都存在的线程
+    [[nodiscard]] auto operator-(const ResourceSample& older) const -> ResourceSample;
+};
+
+// 后台定期采样进程资源, 结果放在预分配的 ring 中, 稳定后采样不再分配内存
+// (线程数不超过 max_threads 时).
+class ResourceSampler {
+public:
+    struct Options {
+        std::chrono::milliseconds interval{1000};
+        // ring 中保留的样本数
+        size_t capacity = 600;
+        bool per_thread = true;
+        size_t max_threads = 256;
+    };
+
+    explicit ResourceSampler(Options opts);
+
+    ResourceSampler(const ResourceSampler&) = delete;
+    ResourceSampler(ResourceSampler&&) = delete;
+    auto operator=(const ResourceSampler&) -> ResourceSampler& = delete;
+    auto operator=(ResourceSampler&&) -> ResourceSampler& = delete;
+
+    ~ResourceSampler();
+
+    void start();
+
+    void stop();
+
+    // 立即采样一次并写入 ring
+    auto sample() -> ResourceSample;
+
+    // 最新的样本, 还没有样本时返回默认值
+    [[nodiscard]] auto latest() const -> ResourceSample;
+
+    // ring 中所有样本, 从旧到新
+    [[nodiscard]] auto history() const -> std::vector<ResourceSample>;
+
+    // 最新样本与 window 之前 (或 ring 中最旧) 的样本之差
+    [[nodiscard]] auto delta(std::chrono::steady_clock::duration window) const -> ResourceSample;
+
+private:
+    void loop();
+    void collect_and_push();
+
+    Options opts_;
+
+    // 串行化采集, 保护 scratch_
+    std::mutex collect_mutex_;
+    // 保护 ring 和 stop_
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<ResourceSample> ring_;
+    size_t next_ = 0;
+    size_t size_ = 0;
+    bool stop_ = false;
+    ResourceSample scratch_;
+    std::thread worker_;
+};